@@ -0,0 +1,147 @@
+/* Alpha-beta reference agent.
+ *
+ * Reference opponent built on abengine.c, plays through client.c like the
+ * MCTS agent so it drops in wherever lookt was used:
+ *
+ * ./abt -p 12345 -d 16     fixed depth, like lookt -d
+ * ./abt -p 12345 -t 500    iterative deepening for 500ms a move
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mcts.h"
+#include "common.h"
+#include "agent.h"
+#include "abengine.h"
+
+// Used by the linked in search code.
+int verbose = FALSE;
+int moveNo;
+
+State *state;
+int searchDepth = 0;
+uint32_t searchMs = 0;
+
+/*********************************************************/ /*
+    Print usage information and exit
+ */
+void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       -v");
+    printf("       [-p port]\n");   // tcp port
+    printf("       [-h host]\n");   // tcp host
+    printf("       [-d depth]\n");  // search depth
+    printf("       [-t ms]\n");     // time per move
+    exit(1);
+}
+
+/*********************************************************/ /*
+    Parse command-line arguments
+ */
+void agent_parse_args(int argc, char *argv[]) {
+    int i = 1;
+    while (i < argc) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = TRUE;
+            ++i;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            port = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-h") == 0) {
+            host = argv[i + 1];
+        } else if (strcmp(argv[i], "-d") == 0) {
+            searchDepth = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            searchMs = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    // Plays in well under a second on most positions.
+    if (searchDepth <= 0 && searchMs == 0) {
+        searchDepth = 9;
+    }
+}
+
+/*********************************************************/ /*
+    Called at the beginning of a series of games
+ */
+void agent_init() {}
+
+/*********************************************************/ /*
+    Called at the beginning of each game
+ */
+void agent_start(int this_player) { (void)this_player; }
+
+/*********************************************************/ /*
+    Search the current state and play the move
+ */
+static int ab_move(void) {
+    AbResult result;
+    int ourMove = abSearch(state, searchDepth, searchMs, &result);
+    if (verbose) {
+        fprintf(stderr, "T:%d Mv: %d score: %d depth: %d nodes: %lu\n",
+                moveNo, ourMove, result.score, result.depth,
+                (unsigned long)result.nodes);
+    }
+    stateDoMove(state, ourMove);
+    // Convert the move back into index 1
+    return ourMove + 1;
+}
+
+/*********************************************************/ /*
+    Choose second move and return it
+ */
+int agent_second_move(int board_num, int prev_move) {
+    moveNo = 2;
+    state = initState(board_num - 1, prev_move - 1, -1);
+    return ab_move();
+}
+
+/*********************************************************/ /*
+    Choose third move and return it
+ */
+int agent_third_move(int board_num, int first_move, int prev_move) {
+    moveNo = 3;
+    state = initState(board_num - 1, prev_move - 1, first_move - 1);
+    return ab_move();
+}
+
+/*********************************************************/ /*
+    Choose next move and return it
+ */
+int agent_next_move(int prev_move) {
+    moveNo += 2;
+    stateDoMove(state, prev_move - 1);
+    return ab_move();
+}
+
+/*********************************************************/ /*
+    Receive last move and mark it on the board
+ */
+void agent_last_move(int prev_move) {
+    ++moveNo;
+    (void)prev_move;
+}
+
+/*********************************************************/ /*
+    Called after each game
+ */
+void agent_gameover(int result, int cause) {
+    free(state);
+    state = NULL;
+    (void)result;
+    (void)cause;
+}
+
+/*********************************************************/ /*
+    Called after the series of games
+ */
+void agent_cleanup() { abCleanup(); }
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "abengine.h"
+#include "eval.h"
+
+#define TRUE 1
+#define FALSE 0
+
+// Check the clock every 4096 nodes.
+#define AB_CLOCK_MASK 4095u
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+
+typedef struct abEntry {
+    uint64_t key;
+    int32_t score;
+    uint8_t depth;
+    uint8_t flag;
+    uint8_t move;
+} AbEntry;
+
+static AbEntry *table = NULL;
+// Cutoff counts indexed by sub-board and move.
+static uint32_t history[BOARD_SIZE][BOARD_SIZE];
+static uint64_t nodes;
+static int aborted;
+static int timed;
+static struct timespec deadline;
+
+static uint64_t stateHash(State *state) {
+    uint64_t h = (uint64_t)state->subBoard * 9 + state->playerLastMoved;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        h = (h ^ state->board[i]) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 29;
+    }
+    return h | 1;
+}
+
+static int pastDeadline(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline.tv_sec ||
+           (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+}
+
+// Win scores are stored relative to the node so they survive transpositions.
+static int scoreToTable(int score, int ply) {
+    if (score > AB_WIN_THRESHOLD) {
+        return score + ply;
+    } else if (score < -AB_WIN_THRESHOLD) {
+        return score - ply;
+    }
+    return score;
+}
+
+static int scoreFromTable(int score, int ply) {
+    if (score > AB_WIN_THRESHOLD) {
+        return score - ply;
+    } else if (score < -AB_WIN_THRESHOLD) {
+        return score + ply;
+    }
+    return score;
+}
+
+static void orderMoves(State *state, Move moves[BOARD_SIZE], uint32_t nMoves,
+                       Move first) {
+    uint32_t keys[BOARD_SIZE];
+    for (uint32_t i = 0; i < nMoves; i++) {
+        keys[i] = moves[i] == first ? UINT32_MAX
+                                    : history[state->subBoard][moves[i]];
+    }
+    // Insertion sort, there are at most 9.
+    for (uint32_t i = 1; i < nMoves; i++) {
+        Move m = moves[i];
+        uint32_t k = keys[i];
+        uint32_t j = i;
+        for (; j > 0 && keys[j - 1] < k; j--) {
+            moves[j] = moves[j - 1];
+            keys[j] = keys[j - 1];
+        }
+        moves[j] = m;
+        keys[j] = k;
+    }
+}
+
+static int negamax(State *state, int depth, int ply, int alpha, int beta,
+                   Move *bestMove) {
+    if (timed && (++nodes & AB_CLOCK_MASK) == 0 && pastDeadline()) {
+        aborted = TRUE;
+    } else if (!timed) {
+        ++nodes;
+    }
+    if (aborted) {
+        return 0;
+    }
+
+    int player = 3 - state->playerLastMoved;
+    uint32_t wins = stateThreats(state->board[state->subBoard], player);
+    if (wins) {
+        *bestMove = __builtin_ctz(wins);
+        return AB_WIN_SCORE - ply - 1;
+    }
+
+    if (depth <= 0) {
+        return evalState(state, player);
+    }
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    stateGetMoves(state, moves, &nMoves);
+    *bestMove = moves[0];
+
+    uint64_t key = stateHash(state);
+    AbEntry *entry = &table[key & ((1u << AB_TT_BITS) - 1)];
+    Move ttMove = BOARD_SIZE;
+    if (entry->key == key) {
+        int score = scoreFromTable(entry->score, ply);
+        ttMove = entry->move;
+        if (entry->depth >= depth &&
+            (entry->flag == TT_EXACT ||
+             (entry->flag == TT_LOWER && score >= beta) ||
+             (entry->flag == TT_UPPER && score <= alpha))) {
+            *bestMove = ttMove;
+            return score;
+        }
+    }
+    orderMoves(state, moves, nMoves, ttMove);
+
+    int origAlpha = alpha;
+    int best = -AB_WIN_SCORE - 1;
+    for (uint32_t i = 0; i < nMoves; i++) {
+        State child = *state;
+        Move reply;
+        int score;
+        stateDoMove(&child, moves[i]);
+        if (child.gameStatus == GAME_DRAWN) {
+            score = 0;
+        } else if (stateThreats(child.board[child.subBoard], 3 - player)) {
+            // They finish a line next move.
+            score = -(AB_WIN_SCORE - ply - 2);
+        } else {
+            score = -negamax(&child, depth - 1, ply + 1, -beta, -alpha,
+                             &reply);
+            if (aborted) {
+                return 0;
+            }
+        }
+        if (score > best) {
+            best = score;
+            *bestMove = moves[i];
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (alpha >= beta) {
+            history[state->subBoard][moves[i]] += (uint32_t)(depth * depth);
+            break;
+        }
+    }
+
+    entry->key = key;
+    entry->score = scoreToTable(best, ply);
+    entry->depth = (uint8_t)depth;
+    entry->move = *bestMove;
+    entry->flag = best <= origAlpha ? TT_UPPER
+                  : best >= beta    ? TT_LOWER
+                                    : TT_EXACT;
+    return best;
+}
+
+int abSearch(State *state, int maxDepth, uint32_t maxMs, AbResult *result) {
+    memset(result, 0, sizeof(AbResult));
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    stateGetMoves(state, moves, &nMoves);
+    result->move = moves[0];
+    if (table == NULL) {
+        table = calloc(1u << AB_TT_BITS, sizeof(AbEntry));
+        if (table == NULL) {
+            return result->move;
+        }
+    }
+    if (maxDepth < 1 || maxDepth > AB_MAX_DEPTH) {
+        maxDepth = AB_MAX_DEPTH;
+    }
+    memset(history, 0, sizeof(history));
+
+    timed = maxMs > 0;
+    if (timed) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += maxMs / 1000;
+        deadline.tv_nsec += (long)(maxMs % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    nodes = 0;
+    aborted = FALSE;
+
+    for (int depth = 1; depth <= maxDepth; depth++) {
+        State root = *state;
+        Move move;
+        int score = negamax(&root, depth, 0, -AB_WIN_SCORE - 1,
+                            AB_WIN_SCORE + 1, &move);
+        if (aborted) {
+            break;
+        }
+        result->move = move;
+        result->score = score;
+        result->depth = depth;
+        // Nothing more to find once the game is decided.
+        if (score > AB_WIN_THRESHOLD || score < -AB_WIN_THRESHOLD) {
+            break;
+        }
+    }
+    result->nodes = nodes;
+    return result->move;
+}
+
+void abCleanup(void) {
+    free(table);
+    table = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef __ABENGINE_H__
+#define __ABENGINE_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Bitboard negamax alpha-beta engine with iterative deepening, a
+ * transposition table and history move ordering. It's a transparent stand in
+ * for lookt as a reference opponent, see abagent.c for the client side. */
+
+#define AB_MAX_DEPTH 64
+// Scores above this are forced wins, WIN_SCORE minus the plies to get there.
+#define AB_WIN_SCORE 100000
+#define AB_WIN_THRESHOLD (AB_WIN_SCORE - 1000)
+// log2 of the number of transposition table entries, 16 bytes each.
+#define AB_TT_BITS 20
+
+typedef struct abResult {
+    Move move;
+    // Score of move for the player to move, see AB_WIN_SCORE.
+    int score;
+    // Deepest iteration that finished.
+    int depth;
+    uint64_t nodes;
+} AbResult;
+
+/* Search state for the player to move, deepening one ply at a time up to
+ * maxDepth or until maxMs has passed (0 for no time limit). The move from the
+ * last finished iteration is returned and written to result. */
+int abSearch(State *state, int maxDepth, uint32_t maxMs, AbResult *result);
+void abCleanup(void);
+
+#endif
@@ -37,6 +37,13 @@
 #include "common.h"
 #include "agent.h"
 #include "game.h"
+#include "perf.h"
+#include "book.h"
+#include "solver.h"
+#include "dist.h"
+#include "store.h"
+#include "analysis.h"
+#include "rng.h"
 
 #define MAX_MOVE 81
 
@@ -48,7 +55,34 @@ uint32_t totalMs = 0;
 // Boards/squares Indexed from 1.
 int firstMove[2];
 int verbose = FALSE;
-uint32_t targetTurnTime = FAST_TARGET_TURN_TIME;
+// Report hardware performance counters to stderr.
+int profile = FALSE;
+// Opening book given with -b, otherwise DEFAULT_BOOK_FILE if it's there.
+char *bookFile = NULL;
+// Rollout policy weights given with -w, otherwise DEFAULT_POLICY_FILE.
+char *policyFile = NULL;
+// Network weights given with -m, otherwise DEFAULT_NN_FILE.
+char *netFile = NULL;
+// Position store given with -s, off without it.
+char *storeFile = NULL;
+// Slots to create it with if it doesn't exist yet.
+uint32_t storeEntries = DEFAULT_STORE_ENTRIES;
+// Where -a sends live analysis, nowhere without it.
+char *analysisSpec = NULL;
+// Local search worker processes given with -j.
+int localWorkers = 0;
+// searchd addresses given with -W.
+char *remoteWorkers[DIST_MAX_WORKERS];
+int numRemoteWorkers = 0;
+// Time saved by answering from the book, spent on mid-game turns instead.
+uint32_t bankedMs = 0;
+// Search RNG seed given with -r, otherwise taken from the clock.
+int haveSeed = FALSE;
+uint64_t seed;
+// Game log given with -l, see replay.c.
+char *logFile = NULL;
+FILE *logFp = NULL;
+int gameNo = 0;
 
 /*********************************************************/ /*
     Print usage information and exit
@@ -56,6 +90,19 @@ uint32_t targetTurnTime = FAST_TARGET_TURN_TIME;
 void usage(char argv0[]) {
     printf("Usage: %s\n", argv0);
     printf("       -v");
+    printf("       -P");  // hardware counter profiling
+    printf("       [-b book_file]\n");
+    printf("       [-c name=value,...]\n");  // search settings, see mcts.h
+    mctsModelUsage();
+    printf("       [-s store_file]\n");       // shared position stats
+    printf("       [-S store_entries]\n");    // size of a new store
+    printf("       [-a stderr|file|tcp:host:port|unix:path]\n");  // analysis
+    printf("       [-A ms]\n");               // analysis interval
+    printf("       [-j workers]\n");          // local search processes
+    printf("       [-W host:port|unix:path]\n");  // searchd, repeatable
+    printf("       [-r seed]\n");            // search RNG seed
+    printf("       [-i iterations]\n");      // fixed budget, ignores clock
+    printf("       [-l log_file]\n");        // game log for replay
     printf("       [-p port]\n");  // tcp port
     printf("       [-h host]\n");  // tcp host
     exit(1);
@@ -82,6 +129,91 @@ void agent_parse_args(int argc, char *argv[]) {
         } else if (strcmp(argv[i], "-v") == 0) {
             verbose = TRUE;
             ++i;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            bookFile = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            if (i + 1 >= argc || mctsConfigParse(&mctsConfig, argv[i + 1])) {
+                usage(argv[0]);
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            policyFile = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            netFile = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            storeFile = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-S") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            storeEntries = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            i += 2;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            analysisSpec = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-A") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            analysisIntervalMs = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            i += 2;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            localWorkers = atoi(argv[i + 1]);
+            i += 2;
+        } else if (strcmp(argv[i], "-W") == 0) {
+            if (i + 1 >= argc || numRemoteWorkers == DIST_MAX_WORKERS) {
+                usage(argv[0]);
+            }
+            remoteWorkers[numRemoteWorkers++] = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-r") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            seed = strtoull(argv[i + 1], NULL, 10);
+            haveSeed = TRUE;
+            i += 2;
+        } else if (strcmp(argv[i], "-i") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            if (maxIterations < 1) {
+                usage(argv[0]);
+            }
+            fixedBudget = TRUE;
+            i += 2;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+            }
+            logFile = argv[i + 1];
+            i += 2;
+        } else if (strcmp(argv[i], "-P") == 0) {
+            profile = TRUE;
+            ++i;
         } else {
             usage(argv[0]);
         }
@@ -95,14 +227,106 @@ void agent_init() {
     struct timeval tp;
 
     // generate a new random seed each time
-    gettimeofday(&tp, NULL);
-    srand((unsigned int)(tp.tv_usec));
+    if (!haveSeed) {
+        gettimeofday(&tp, NULL);
+        seed = (uint64_t)tp.tv_sec * 1000000 + tp.tv_usec;
+    }
+    rngSeed(seed);
+
+    if (profile) {
+        perfInit();
+    }
+
+    // Without a book we just search the opening moves like any other.
+    if (bookOpen(bookFile ? bookFile : DEFAULT_BOOK_FILE) != 0 && bookFile) {
+        fprintf(stderr, "Couldn't load opening book %s\n", bookFile);
+    }
+    // Plays on without a file it couldn't load.
+    mctsLoadModels(policyFile, netFile);
+
+    if (storeFile && storeOpen(storeFile, storeEntries) != 0) {
+        fprintf(stderr, "Couldn't open position store %s\n", storeFile);
+    }
+
+    // Their share of the search is down to the clock.
+    if (fixedBudget && (localWorkers > 0 || numRemoteWorkers > 0)) {
+        fprintf(stderr, "Not using search workers with -i\n");
+        localWorkers = 0;
+        numRemoteWorkers = 0;
+    }
+    // Workers fork from here so they share everything loaded above.
+    if (localWorkers > 0) {
+        distSpawnLocal(localWorkers);
+    }
+    for (int i = 0; i < numRemoteWorkers; i++) {
+        if (distConnect(remoteWorkers[i]) != 0) {
+            fprintf(stderr, "Couldn't reach search worker %s\n",
+                    remoteWorkers[i]);
+        }
+    }
+    // After the fork so only this process reports.
+    if (analysisSpec && analysisOpen(analysisSpec) != 0) {
+        fprintf(stderr, "Couldn't open analysis output %s\n", analysisSpec);
+    }
+
+    if (logFile) {
+        logFp = fopen(logFile, "w");
+        if (logFp == NULL) {
+            perror(logFile);
+        } else {
+            fprintf(logFp, "seed %llu iterations %u fixed %d\nconfig ",
+                    (unsigned long long)seed, maxIterations, fixedBudget);
+            mctsConfigPrint(logFp, &mctsConfig);
+            fflush(logFp);
+        }
+    }
+}
+
+/*********************************************************/ /*
+    Search the current position and log it with what replay needs to redo it
+ */
+static int agent_search(int prev_move, uint32_t turnTime) {
+    uint64_t startRng = rngState;
+    int move = distSearch(state, prev_move, turnTime);
+    if (logFp) {
+        fprintf(logFp, "search %d %d %d %d", moveNo, prev_move,
+                state->subBoard, state->playerLastMoved);
+        for (int b = 0; b < BOARD_SIZE; b++) {
+            fprintf(logFp, " %x", state->board[b]);
+        }
+        fprintf(logFp, " %016llx %u %d\n", (unsigned long long)startRng,
+                mctsStats.iterations, move);
+        fflush(logFp);
+    }
+    return move;
+}
+
+/*********************************************************/ /*
+    Look up the book move for the current state, -1 if there isn't a legal one
+ */
+static int book_move(int index) {
+    int move = bookLookup(index);
+    if (move < 0 || (state->board[state->subBoard] &
+                     ((CIRCLE_PLAYER_START | CROSS_PLAYER_START) << move))) {
+        return -1;
+    }
+    bankedMs += mctsConfig.firstTurnMs;
+    if (logFp) {
+        fprintf(logFp, "book %d %d\n", moveNo, move);
+    }
+    return move;
 }
 
 /*********************************************************/ /*
     Called at the beginning of each game
  */
-void agent_start(int this_player) { (void)this_player; }
+void agent_start(int this_player) {
+    // Time left from the last game's book moves isn't this game's.
+    bankedMs = 0;
+    if (logFp) {
+        fprintf(logFp, "game %d %c\n", ++gameNo, this_player ? 'o' : 'x');
+    }
+}
 
 /*********************************************************/ /*
     Choose second move and return it
@@ -119,7 +343,10 @@ int agent_second_move(int board_num, int prev_move) {
     state = initState(board_num, prev_move, -1);
 
     gettimeofday(&start, NULL);
-    int ourMove = run_mcts(state, prev_move, FIRST_TURN_TIME);
+    int ourMove = book_move(bookSecondIndex(board_num, prev_move));
+    if (ourMove < 0) {
+        ourMove = agent_search(prev_move, mctsConfig.firstTurnMs);
+    }
     gettimeofday(&fin, NULL);
 
     uint32_t move_msec = move_msec = 1 + (fin.tv_sec - start.tv_sec) * 1000 +
@@ -147,7 +374,11 @@ int agent_third_move(int board_num, int first_move, int prev_move) {
     state = initState(board_num, prev_move, first_move);
 
     gettimeofday(&start, NULL);
-    int ourMove = run_mcts(state, prev_move, FIRST_TURN_TIME);
+    int ourMove =
+        book_move(bookThirdIndex(board_num, first_move, prev_move));
+    if (ourMove < 0) {
+        ourMove = agent_search(prev_move, mctsConfig.firstTurnMs);
+    }
     gettimeofday(&fin, NULL);
 
     uint32_t move_msec = move_msec = 1 + (fin.tv_sec - start.tv_sec) * 1000 +
@@ -170,14 +401,23 @@ int agent_next_move(int prev_move) {
     stateDoMove(state, prev_move);
 
     // Take longer turn times during the mid-late game.
-    if (moveNo > 9) {
-        targetTurnTime = MAX_TARGET_TURN_TIME;
-    } else if (moveNo > 31) {
-        targetTurnTime = END_GAME_TURN_TIME;
+    uint32_t turnTime =
+        moveNo > 9 ? mctsConfig.maxTurnMs : mctsConfig.fastTurnMs;
+
+    /* Spread the time the book saved us over the next few mid-game turns,
+     * at most a first turn's worth each, but keep it for later when run_mcts
+     * is going to cut this one short. */
+    if (moveNo > 9 && bankedMs > 0 && !mctsShortTurn()) {
+        uint32_t bonus = bankedMs / 2 > 250 ? bankedMs / 2 : bankedMs;
+        if (bonus > (uint32_t)mctsConfig.firstTurnMs) {
+            bonus = mctsConfig.firstTurnMs;
+        }
+        turnTime += bonus;
+        bankedMs -= bonus;
     }
 
     gettimeofday(&start, NULL);
-    int ourMove = run_mcts(state, prev_move, targetTurnTime);
+    int ourMove = agent_search(prev_move, turnTime);
     gettimeofday(&fin, NULL);
 
     uint32_t move_msec = move_msec = 1 + (fin.tv_sec - start.tv_sec) * 1000 +
@@ -208,6 +448,12 @@ void agent_gameover(int result, int cause) {
     printf("%c,%c,%d.%d,%d,%u\n", resultMap[result - WIN],
            meMap[state->me - CIRCLE_PLAYER], firstMove[0], firstMove[1], moveNo,
            totalMs);
+    perfReport(stderr);
+    if (logFp) {
+        fprintf(logFp, "result %c %d %u\n", resultMap[result - WIN], moveNo,
+                totalMs);
+        fflush(logFp);
+    }
     free(state);
     (void)cause;
 }
@@ -216,5 +462,13 @@ void agent_gameover(int result, int cause) {
     Called after the series of games
  */
 void agent_cleanup() {
-    // nothing to do here
+    if (logFp) {
+        fclose(logFp);
+    }
+    distCleanup();
+    analysisClose();
+    storeClose();
+    perfCleanup();
+    bookClose();
+    solverCleanup();
 }
@@ -6,7 +6,6 @@
  */
 extern int port;
 extern char *host;
-extern double ucb_const;
 extern int verbose;
 extern int moveNo;
 
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+#include "agent.h"
+#include "analysis.h"
+
+#define ANALYSIS_LINE 1024
+// Longest principal variation printed.
+#define ANALYSIS_PV 24
+
+int analysisEnabled = FALSE;
+uint32_t analysisIntervalMs = DEFAULT_ANALYSIS_MS;
+
+static int analysisFd = -1;
+// Tail of a line a socket only took part of, sent before anything new.
+static char pending[ANALYSIS_LINE];
+static size_t pendingLen = 0;
+
+static int connectSpec(const char *spec) {
+    int fd = -1;
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, spec + 5, sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+            connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    char host[256];
+    const char *colon = strrchr(spec + 4, ':');
+    struct addrinfo hints, *res, *ai;
+    if (colon == NULL || (size_t)(colon - spec - 4) >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, spec + 4, colon - spec - 4);
+    host[colon - spec - 4] = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0) {
+        return -1;
+    }
+    for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int analysisOpen(const char *spec) {
+    int fd;
+    analysisClose();
+    if (strcmp(spec, "stderr") == 0) {
+        fd = dup(STDERR_FILENO);
+    } else if (strncmp(spec, "unix:", 5) == 0 ||
+               strncmp(spec, "tcp:", 4) == 0) {
+        fd = connectSpec(spec);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    } else {
+        fd = open(spec, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    analysisFd = fd;
+    pendingLen = 0;
+    analysisEnabled = TRUE;
+    return 0;
+}
+
+void analysisClose(void) {
+    if (analysisFd >= 0) {
+        close(analysisFd);
+    }
+    analysisFd = -1;
+    analysisEnabled = FALSE;
+}
+
+// Write what we can of buf without waiting, returns how much went.
+static size_t writeSome(const char *buf, size_t len) {
+    ssize_t n = send(analysisFd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno == ENOTSOCK) {
+        /* A pipe or tty nobody is reading would block write(), and the fd
+         * shares O_NONBLOCK with our own stderr so that's left alone. A line
+         * it can't take now is dropped. */
+        struct pollfd pfd = {analysisFd, POLLOUT, 0};
+        if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLOUT)) {
+            return len;
+        }
+        n = write(analysisFd, buf, len);
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        // The other end went away, stop bothering.
+        analysisClose();
+        return len;
+    }
+    return n < 0 ? 0 : (size_t)n;
+}
+
+void analysisReport(Node *root, uint32_t iterations, uint32_t elapsed,
+                    int done) {
+    char line[ANALYSIS_LINE];
+    Node *children[BOARD_SIZE];
+    int n = 0;
+    size_t len;
+
+    if (!analysisEnabled) {
+        return;
+    }
+    if (pendingLen > 0) {
+        size_t sent = writeSome(pending, pendingLen);
+        memmove(pending, pending + sent, pendingLen - sent);
+        pendingLen -= sent;
+        if (pendingLen > 0) {
+            return;
+        }
+    }
+
+    // Root children most visited first, there are at most 9.
+    for (int i = 0; i < BOARD_SIZE && root->children[i] != NULL; i++) {
+        Node *child = root->children[i];
+        int j = n++;
+        for (; j > 0 && children[j - 1]->visits < child->visits; j--) {
+            children[j] = children[j - 1];
+        }
+        children[j] = child;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    len = snprintf(line, sizeof(line),
+                   "T:%d%s ms:%u iters:%u ips:%.0lf best:%d q:%.2lf root:",
+                   moveNo, done ? " final" : "", elapsed, iterations,
+                   elapsed ? 1000.0 * iterations / elapsed : 0.0,
+                   children[0]->move,
+                   children[0]->wins / (children[0]->visits + 1e-9));
+    for (int i = 0; i < n && len < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%d=%u/%.2lf",
+                        i ? "," : "", children[i]->move, children[i]->visits,
+                        children[i]->wins / (children[i]->visits + 1e-9));
+    }
+    if (len < sizeof(line)) {
+        len += snprintf(line + len, sizeof(line) - len, " pv:");
+    }
+    Node *node = root;
+    for (int depth = 0; depth < ANALYSIS_PV && len < sizeof(line); depth++) {
+        Node *best = NULL;
+        for (int i = 0; i < BOARD_SIZE && node->children[i] != NULL; i++) {
+            if (best == NULL || node->children[i]->visits > best->visits) {
+                best = node->children[i];
+            }
+        }
+        if (best == NULL) {
+            break;
+        }
+        len += snprintf(line + len, sizeof(line) - len, "%s%d",
+                        depth ? " " : "", best->move);
+        node = best;
+    }
+    if (len >= sizeof(line) - 1) {
+        len = sizeof(line) - 2;
+    }
+    line[len++] = '\n';
+
+    size_t sent = writeSome(line, len);
+    if (analysisEnabled && sent < len) {
+        memcpy(pending, line + sent, len - sent);
+        pendingLen = len - sent;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef __ANALYSIS_H__
+#define __ANALYSIS_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Live analysis output while run_mcts is searching.
+ *
+ * Every analysisIntervalMs of search, and once when it finishes, one line
+ * goes to the analysis channel:
+ *
+ * T:12 ms:300 iters:712704 ips:2375680 best:4 q:0.56 root:4=310021/0.56,...
+ * pv:4 2 7
+ *
+ * (all on one line) with moves from 0 like the rest of the engine, root
+ * children as move=visits/win rate, most visited first, and pv the most
+ * visited path down the tree. The channel is stderr, a file, or a TCP or
+ * Unix socket, never the client's connection. Writes never block: a socket
+ * that can't take a line right now just misses it. */
+
+#define DEFAULT_ANALYSIS_MS 100
+
+extern int analysisEnabled;
+extern uint32_t analysisIntervalMs;
+
+/* Start writing to spec, which is "stderr", "tcp:host:port",
+ * "unix:/path" or a file to append to. Returns 0 on success, -1 if it
+ * couldn't be opened. */
+int analysisOpen(const char *spec);
+void analysisClose(void);
+
+// Write a line for the search under root, done says it's the last one.
+void analysisReport(Node *root, uint32_t iterations, uint32_t elapsed,
+                    int done);
+
+#endif
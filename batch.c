@@ -0,0 +1,257 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#include "batch.h"
+#include "common.h"
+#include "policy.h"
+#include "rng.h"
+#include "solver.h"
+#include "symmetry.h"
+
+// Jobs [head, tail) of the batch left for one thread.
+typedef struct batchQueue {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} BatchQueue;
+
+static pthread_t threads[BATCH_MAX_THREADS];
+static BatchQueue queues[BATCH_MAX_THREADS];
+static int numThreads = 0;
+
+/* Guards generation, bumped to wake the threads for a batch, stopping and
+ * busy, the threads that woke for a batch and haven't gone back to sleep. */
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t threadsIdle = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;
+static int stopping = FALSE;
+static int busy = 0;
+
+/* The batch. Only set, and the queues filled, under poolLock with no thread
+ * busy, else one still stealing from the last batch could take a job twice
+ * or lose some. */
+static BatchJob *jobs = NULL;
+static BatchDone doneFn = NULL;
+static void *doneArg = NULL;
+static MctsConfig callerConfig;
+
+// Guards the callback and remaining.
+static pthread_mutex_t doneLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t allDone = PTHREAD_COND_INITIALIZER;
+static int remaining = 0;
+
+static void runJob(BatchJob *job) {
+    State state = job->state;
+    mctsConfig = job->config ? *job->config : callerConfig;
+    maxIterations = job->maxIterations ? job->maxIterations : MAXITER;
+    fixedBudget = job->fixedBudget;
+    confidence = job->confidence;
+    rngSeed(job->seed);
+    job->move = run_mcts(&state, job->lastMove, job->maxMs);
+    job->confidence = confidence;
+    job->stats = mctsStats;
+}
+
+static void finishJob(int j) {
+    pthread_mutex_lock(&doneLock);
+    if (doneFn != NULL) {
+        doneFn(&jobs[j], j, doneArg);
+    }
+    if (--remaining == 0) {
+        pthread_cond_signal(&allDone);
+    }
+    pthread_mutex_unlock(&doneLock);
+}
+
+static int queueLength(BatchQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    int n = q->tail - q->head;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+/* Moves the back half of the longest queue to self's, which is empty, and
+ * returns the first of them to run. -1 when there's nothing left anywhere.
+ * Only one lock is held at a time, so two thieves can't deadlock. */
+static int stealJob(int self) {
+    for (;;) {
+        int victim = -1;
+        int longest = 0;
+        for (int t = 0; t < numThreads; t++) {
+            int n = queueLength(&queues[t]);
+            if (n > longest) {
+                longest = n;
+                victim = t;
+            }
+        }
+        if (victim < 0) {
+            return -1;
+        }
+
+        BatchQueue *q = &queues[victim];
+        pthread_mutex_lock(&q->lock);
+        int n = q->tail - q->head;
+        int first = q->tail - (n + 1) / 2;
+        int last = q->tail;
+        q->tail = first;
+        pthread_mutex_unlock(&q->lock);
+        if (n == 0) {
+            // Emptied since we looked.
+            continue;
+        }
+
+        q = &queues[self];
+        pthread_mutex_lock(&q->lock);
+        q->head = first + 1;
+        q->tail = last;
+        pthread_mutex_unlock(&q->lock);
+        return first;
+    }
+}
+
+static int takeJob(int self) {
+    BatchQueue *q = &queues[self];
+    int j = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->head < q->tail) {
+        j = q->head++;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return j >= 0 ? j : stealJob(self);
+}
+
+static void *batchThread(void *arg) {
+    int self = (int)(intptr_t)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&poolLock);
+    for (;;) {
+        while (!stopping && generation == seen) {
+            pthread_cond_wait(&workReady, &poolLock);
+        }
+        if (stopping) {
+            break;
+        }
+        seen = generation;
+        busy++;
+        pthread_mutex_unlock(&poolLock);
+
+        for (int j = takeJob(self); j >= 0; j = takeJob(self)) {
+            runJob(&jobs[j]);
+            finishJob(j);
+        }
+        pthread_mutex_lock(&poolLock);
+        if (--busy == 0) {
+            pthread_cond_signal(&threadsIdle);
+        }
+    }
+    pthread_mutex_unlock(&poolLock);
+
+    solverCleanup();
+    mctsArenaFree();
+    return NULL;
+}
+
+int batchStart(int count) {
+    // Fill in the shared tables now, run_mcts would race to do it.
+    symmetryInit();
+    policyInit();
+
+    if (count > BATCH_MAX_THREADS) {
+        count = BATCH_MAX_THREADS;
+    }
+    // Every queue is ready before any thread can look at it.
+    for (int t = 0; t < count; t++) {
+        pthread_mutex_init(&queues[t].lock, NULL);
+        queues[t].head = 0;
+        queues[t].tail = 0;
+    }
+    numThreads = count > 0 ? count : 0;
+    for (int t = 0; t < count; t++) {
+        if (pthread_create(&threads[t], NULL, batchThread,
+                           (void *)(intptr_t)t) != 0) {
+            for (int u = t; u < count; u++) {
+                pthread_mutex_destroy(&queues[u].lock);
+            }
+            // Threads from t on never started, batchStop joins the rest.
+            numThreads = t;
+            batchStop();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void batchSearch(BatchJob *batch, int n, BatchDone done, void *arg) {
+    if (n <= 0) {
+        return;
+    }
+
+    if (numThreads == 0) {
+        // One at a time on this thread, leaving its own search state as is.
+        MctsConfig config = mctsConfig;
+        uint32_t iterations = maxIterations;
+        int fixed = fixedBudget;
+        double conf = confidence;
+        uint64_t rng = rngState;
+        callerConfig = config;
+        for (int j = 0; j < n; j++) {
+            runJob(&batch[j]);
+            if (done != NULL) {
+                done(&batch[j], j, arg);
+            }
+        }
+        mctsConfig = config;
+        maxIterations = iterations;
+        fixedBudget = fixed;
+        confidence = conf;
+        rngState = rng;
+        return;
+    }
+
+    pthread_mutex_lock(&poolLock);
+    while (busy > 0) {
+        pthread_cond_wait(&threadsIdle, &poolLock);
+    }
+    callerConfig = mctsConfig;
+    jobs = batch;
+    doneFn = done;
+    doneArg = arg;
+    pthread_mutex_lock(&doneLock);
+    remaining = n;
+    pthread_mutex_unlock(&doneLock);
+    for (int t = 0; t < numThreads; t++) {
+        pthread_mutex_lock(&queues[t].lock);
+        queues[t].head = (int)((int64_t)n * t / numThreads);
+        queues[t].tail = (int)((int64_t)n * (t + 1) / numThreads);
+        pthread_mutex_unlock(&queues[t].lock);
+    }
+    generation++;
+    pthread_cond_broadcast(&workReady);
+    pthread_mutex_unlock(&poolLock);
+
+    pthread_mutex_lock(&doneLock);
+    while (remaining > 0) {
+        pthread_cond_wait(&allDone, &doneLock);
+    }
+    pthread_mutex_unlock(&doneLock);
+}
+
+void batchStop(void) {
+    pthread_mutex_lock(&poolLock);
+    stopping = TRUE;
+    pthread_cond_broadcast(&workReady);
+    pthread_mutex_unlock(&poolLock);
+
+    // Threads can be stealing to the last, so only free locks once all
+    // have gone.
+    for (int t = 0; t < numThreads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int t = 0; t < numThreads; t++) {
+        pthread_mutex_destroy(&queues[t].lock);
+    }
+    numThreads = 0;
+    stopping = FALSE;
+}
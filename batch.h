@@ -0,0 +1,61 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Many run_mcts searches at once, for offline jobs like test suites, book
+ * building and labelling training positions.
+ *
+ * batchStart makes a pool of threads and batchSearch hands it a batch of
+ * positions, each with its own budget, settings and seed. The batch is split
+ * into one contiguous range per thread, a thread takes jobs from the front
+ * of its own range and, when that runs out, steals the back half of the
+ * longest one left, so short and long searches even out. Results come back
+ * through a callback as each search finishes, and batchSearch returns once
+ * they all have.
+ *
+ * A search's state (settings, counters, RNG, solver table and node arena,
+ * see mcts.h) is per thread, and each job reseeds the RNG and starts from an
+ * empty tree, so with fixedBudget a job's result doesn't depend on the
+ * thread that ran it or the number of threads. Load the policy and network
+ * before batchStart, they're shared read-only. The store, analysis output
+ * and perf counters are process wide and not thread safe, leave them off. */
+
+#define BATCH_MAX_THREADS 256
+
+typedef struct batchJob {
+    // In: the position and budget, like run_mcts.
+    State state;
+    Move lastMove;
+    uint32_t maxMs;
+    // 0 for MAXITER.
+    uint32_t maxIterations;
+    int fixedBudget;
+    uint64_t seed;
+    // NULL to use the mctsConfig of the thread that called batchSearch.
+    MctsConfig *config;
+    // In and out, as the global confidence for run_mcts.
+    double confidence;
+
+    // Out.
+    int move;
+    MctsStats stats;
+} BatchJob;
+
+/* Called as each job finishes, with its index in the batch. Calls never
+ * overlap, but come from the pool's threads. */
+typedef void (*BatchDone)(BatchJob *job, int index, void *arg);
+
+/* Start a pool of threads searchers, at most BATCH_MAX_THREADS. Fewer
+ * than 1 runs batches on the calling thread instead. Returns 0, or -1 if the
+ * threads couldn't be made. */
+int batchStart(int threads);
+/* Search the n jobs, calling done (if not NULL) for each as it finishes.
+ * Returns when they're all done. */
+void batchSearch(BatchJob *jobs, int n, BatchDone done, void *arg);
+// Stop and join the threads.
+void batchStop(void);
+
+#endif
@@ -0,0 +1,189 @@
+/* Search benchmark.
+ *
+ * Measures iterations/sec of run_mcts for up to two search settings over a
+ * fixed set of positions, then optionally plays them against each other in
+ * process at a fixed time per move. Each random opening is played twice with
+ * the sides swapped.
+ *
+ * Example, cost and gain of tactical playouts at 100ms a move:
+ * ./bench -a playout_depth=0 -b playout_depth=2 -t 100 -g 40
+ *
+ * True UCB1-tuned variance bounds against the constant 1/4:
+ * ./bench -a ucb_tuned=0 -b ucb_tuned=1 -t 100 -g 200
+ *
+ * Or network leaf evaluation against playouts at equal time:
+ * ./bench -m net.bin -a network=0 -b network=1 -t 100 -g 40
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "policy.h"
+#include "nn.h"
+#include "rng.h"
+
+#define DEFAULT_BENCH_POSITIONS 20
+#define DEFAULT_BENCH_MS 200
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-a name=value,...]\n");  // first config
+    printf("       [-b name=value,...]\n");  // second config
+    printf("       [-t ms]\n");              // per search
+    printf("       [-n positions]\n");       // speed test positions
+    printf("       [-g games]\n");           // match games, a vs b
+    printf("       [-w policy_file]\n");     // rollout policy weights
+    printf("       [-m network_file]\n");    // value/policy network
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+// Random non terminal position plies moves into the game, NULL if we hit one.
+static State *randomPosition(int plies) {
+    State *state = initState(rand() % 9, rand() % 9, -1);
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    for (int p = 0; p < plies; p++) {
+        State next;
+        int tries = 0;
+        stateGetMoves(state, moves, &nMoves);
+        do {
+            next = *state;
+            stateDoMove(&next, moves[(uint32_t)rand() % nMoves]);
+        } while (next.gameStatus != GAME_NOT_TERMINAL && ++tries < 16);
+        if (next.gameStatus != GAME_NOT_TERMINAL) {
+            free(state);
+            return NULL;
+        }
+        *state = next;
+    }
+    return state;
+}
+
+static double benchSpeed(MctsConfig *config, State **positions, int n,
+                         uint32_t ms) {
+    uint64_t iterations = 0;
+    uint64_t elapsed = 0;
+    mctsConfig = *config;
+    for (int p = 0; p < n; p++) {
+        State state = *positions[p];
+        confidence = 0.5;
+        run_mcts(&state, state.subBoard, ms);
+        iterations += mctsStats.iterations;
+        elapsed += mctsStats.elapsedMs;
+    }
+    return elapsed ? 1000.0 * (double)iterations / (double)elapsed : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+    MctsConfig configs[2] = {mctsConfig, mctsConfig};
+    int haveB = FALSE;
+    int numPositions = DEFAULT_BENCH_POSITIONS;
+    int games = 0;
+    uint32_t ms = DEFAULT_BENCH_MS;
+    unsigned int seed = 1;
+    int i = 1;
+
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-a") == 0) {
+            if (mctsConfigParse(&configs[0], argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-b") == 0) {
+            if (mctsConfigParse(&configs[1], argv[i + 1])) {
+                usage(argv[0]);
+            }
+            haveB = TRUE;
+        } else if (strcmp(argv[i], "-t") == 0) {
+            ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            numPositions = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-g") == 0) {
+            games = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (policyLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load policy %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            if (nnLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load network %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    // Fixed time per move, no turn shortening.
+    configs[0].adaptiveTime = FALSE;
+    configs[1].adaptiveTime = FALSE;
+
+    srand(seed);
+    rngSeed(seed);
+    State **positions = calloc(numPositions, sizeof(State *));
+    for (int p = 0; p < numPositions; p++) {
+        while ((positions[p] = randomPosition(4 + (p * 7) % 28)) == NULL) {
+        }
+    }
+
+    for (int c = 0; c <= haveB; c++) {
+        printf("%c: ", 'a' + c);
+        mctsConfigPrint(stdout, &configs[c]);
+        printf("%c: %.0lf iterations/sec over %d positions at %ums\n", 'a' + c,
+               benchSpeed(&configs[c], positions, numPositions, ms),
+               numPositions, ms);
+        fflush(stdout);
+    }
+
+    // Results from a's point of view.
+    int wins = 0, draws = 0, losses = 0;
+    int board = 0, square = 0;
+    for (int g = 0; g < games; g++) {
+        // Each opening twice, a plays X first then O.
+        int aIsCross = g % 2 == 0;
+        if (aIsCross) {
+            board = rand() % 9;
+            square = rand() % 9;
+        }
+        MctsConfig *cross = &configs[aIsCross ? 0 : 1];
+        MctsConfig *circle = &configs[aIsCross ? 1 : 0];
+        int winner = mctsPlayGame(cross, circle, board, square, ms);
+        if (winner == 0) {
+            draws++;
+        } else if (winner == (aIsCross ? CROSS_PLAYER : CIRCLE_PLAYER)) {
+            wins++;
+        } else {
+            losses++;
+        }
+        fprintf(stderr, "\ra vs b W/D/L: %d/%d/%d", wins, draws, losses);
+    }
+    if (games > 0) {
+        double score = (wins + 0.5 * draws) / (double)(wins + draws + losses);
+        double elo = score <= 0.0   ? -INFINITY
+                     : score >= 1.0 ? INFINITY
+                                    : -400.0 * log10(1.0 / score - 1.0);
+        fprintf(stderr, "\n");
+        printf("a vs b W/D/L: %d/%d/%d score: %.3lf elo: %+.0lf\n", wins,
+               draws, losses, score, elo);
+    }
+
+    for (int p = 0; p < numPositions; p++) {
+        free(positions[p]);
+    }
+    free(positions);
+    return 0;
+}
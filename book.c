@@ -0,0 +1,62 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "book.h"
+
+static const uint8_t *bookMoves = NULL;
+static void *bookMap = NULL;
+static size_t bookSize = 0;
+
+int bookOpen(const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 ||
+        (size_t)st.st_size != sizeof(BookHeader) + BOOK_ENTRIES) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is gone.
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const BookHeader *header = map;
+    if (memcmp(header->magic, BOOK_MAGIC, 4) != 0 ||
+        header->version != BOOK_VERSION || header->entries != BOOK_ENTRIES) {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    bookClose();
+    bookMap = map;
+    bookSize = st.st_size;
+    bookMoves = (const uint8_t *)map + sizeof(BookHeader);
+    return 0;
+}
+
+void bookClose(void) {
+    if (bookMap != NULL) {
+        munmap(bookMap, bookSize);
+    }
+    bookMap = NULL;
+    bookMoves = NULL;
+    bookSize = 0;
+}
+
+int bookLookup(int index) {
+    if (bookMoves == NULL || index < 0 || index >= BOOK_ENTRIES ||
+        bookMoves[index] == BOOK_NO_MOVE) {
+        return -1;
+    }
+    return bookMoves[index];
+}
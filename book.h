@@ -0,0 +1,47 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <stdint.h>
+
+/* Opening book for the second and third moves of the game. Those positions
+ * are fully determined by at most three moves so we can search all of them
+ * offline (see bookgen.c) and just look the answer up during play.
+ *
+ * The file is a BookHeader followed by one byte per position holding the
+ * move [0..8] to play, or BOOK_NO_MOVE if the generator didn't get to it or
+ * no game can reach the position.
+ * Second move positions come first, indexed by board * 9 + prev_move, then
+ * third move positions indexed by (board * 9 + first_move) * 9 + prev_move.
+ * Everything is indexed from 0 like the rest of the engine. */
+
+#define BOOK_MAGIC "NBTB"
+#define BOOK_VERSION 1
+#define BOOK_NO_MOVE 0xff
+#define BOOK_SECOND_MOVES 81
+#define BOOK_THIRD_MOVES 729
+#define BOOK_ENTRIES (BOOK_SECOND_MOVES + BOOK_THIRD_MOVES)
+#define DEFAULT_BOOK_FILE "book.bin"
+
+typedef struct bookHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries;
+    uint32_t reserved;
+} BookHeader;
+
+static inline int bookSecondIndex(int board, int prevMove) {
+    return board * 9 + prevMove;
+}
+
+static inline int bookThirdIndex(int board, int firstMove, int prevMove) {
+    return BOOK_SECOND_MOVES + (board * 9 + firstMove) * 9 + prevMove;
+}
+
+/* mmap the book at path. Returns 0 on success, -1 if the file is missing or
+ * isn't a book, in which case lookups simply miss. */
+int bookOpen(const char *path);
+void bookClose(void);
+// Returns the book move [0..8] for index or -1 if there isn't one.
+int bookLookup(int index);
+
+#endif
@@ -0,0 +1,196 @@
+/* Offline opening book generator.
+ *
+ * Searches every second and third move position (see book.h) with a far
+ * bigger budget than a live turn allows and writes the answers to a book file
+ * which the agent mmaps at startup. The positions are split between one
+ * worker process per core, the search keeps its state in globals so processes
+ * are the simplest way of running several at once. Results come back through
+ * a shared anonymous mapping. Positions that are mirror images of one searched
+ * earlier aren't searched again, their move is mapped across instead.
+ *
+ * Example:
+ * ./bookgen -o book.bin -i 4000000 -t 30000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "book.h"
+#include "common.h"
+#include "mcts.h"
+#include "symmetry.h"
+#include "rng.h"
+
+// Node memory grows with iterations, about 120 bytes each.
+#define DEFAULT_BOOK_ITERATIONS 4000000
+#define DEFAULT_BOOK_MS 60000
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-o book_file]\n");
+    printf("       [-i iterations]\n");  // per position
+    printf("       [-t ms]\n");          // per position
+    printf("       [-j workers]\n");
+    exit(1);
+}
+
+// Set up the position for book index idx the same way the agent would.
+static State *bookPosition(int idx) {
+    if (idx < BOOK_SECOND_MOVES) {
+        moveNo = 2;
+        return initState(idx / 9, idx % 9, -1);
+    }
+    idx -= BOOK_SECOND_MOVES;
+    moveNo = 3;
+    return initState(idx / 81, idx % 9, (idx / 9) % 9);
+}
+
+/* Nine third move indices have O on the square X took, in X's own board.
+ * No game gets there, so they're left BOOK_NO_MOVE. */
+static int bookReachable(int idx) {
+    if (idx < BOOK_SECOND_MOVES) {
+        return TRUE;
+    }
+    idx -= BOOK_SECOND_MOVES;
+    int firstMove = (idx / 9) % 9;
+    return !(idx / 81 == firstMove && idx % 9 == firstMove);
+}
+
+static void bookWorker(int worker, int numWorkers, uint32_t ms,
+                       uint8_t *moves, int *toSearch, int numSearch) {
+    srand(worker + 1);
+    rngSeed(worker + 1);
+    for (int n = worker; n < numSearch; n += numWorkers) {
+        int idx = toSearch[n];
+        State *state = bookPosition(idx);
+        // Every position is a fresh search, don't let the last one shorten it.
+        confidence = 0.5;
+        moves[idx] = (uint8_t)run_mcts(state, state->subBoard, ms);
+        free(state);
+        if (worker == 0) {
+            fprintf(stderr, "\rbookgen: %d/%d", n + 1, numSearch);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char *outFile = DEFAULT_BOOK_FILE;
+    uint32_t ms = DEFAULT_BOOK_MS;
+    int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+
+    maxIterations = DEFAULT_BOOK_ITERATIONS;
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            outFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-i") == 0) {
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            numWorkers = atoi(argv[i + 1]);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (numWorkers < 1) {
+        numWorkers = 1;
+    }
+
+    uint8_t *moves = mmap(NULL, BOOK_ENTRIES, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (moves == MAP_FAILED) {
+        perror("bookgen: mmap");
+        return 1;
+    }
+    memset(moves, BOOK_NO_MOVE, BOOK_ENTRIES);
+
+    // Find the first position with the same canonical form as each one.
+    static State canon[BOOK_ENTRIES];
+    static int canonSym[BOOK_ENTRIES];
+    static int rep[BOOK_ENTRIES];
+    static int toSearch[BOOK_ENTRIES];
+    int numSearch = 0;
+    int unreachable = 0;
+    symmetryInit();
+    for (int idx = 0; idx < BOOK_ENTRIES; idx++) {
+        rep[idx] = idx;
+        if (!bookReachable(idx)) {
+            unreachable++;
+            continue;
+        }
+        State *state = bookPosition(idx);
+        canonSym[idx] = stateCanonical(state, &canon[idx]);
+        free(state);
+        for (int j = 0; j < idx; j++) {
+            if (bookReachable(j) &&
+                memcmp(canon[j].board, canon[idx].board,
+                       sizeof(canon[j].board)) == 0 &&
+                canon[j].subBoard == canon[idx].subBoard) {
+                rep[idx] = j;
+                break;
+            }
+        }
+        if (rep[idx] == idx) {
+            toSearch[numSearch++] = idx;
+        }
+    }
+    fprintf(stderr, "bookgen: %d distinct positions\n", numSearch);
+
+    fflush(stdout);
+    for (int w = 0; w < numWorkers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("bookgen: fork");
+            return 1;
+        } else if (pid == 0) {
+            bookWorker(w, numWorkers, ms, moves, toSearch, numSearch);
+            _exit(0);
+        }
+    }
+    while (wait(NULL) > 0) {
+    }
+    fprintf(stderr, "\n");
+
+    // canon = g(position) for both, so undo idx's symmetry on rep's move.
+    for (int idx = 0; idx < BOOK_ENTRIES; idx++) {
+        int r = rep[idx];
+        if (r != idx && moves[r] != BOOK_NO_MOVE) {
+            int m = symSquare[canonSym[r]][moves[r]];
+            moves[idx] = symSquare[symInverse[canonSym[idx]]][m];
+        }
+    }
+
+    int missing = -unreachable;
+    for (int idx = 0; idx < BOOK_ENTRIES; idx++) {
+        missing += moves[idx] == BOOK_NO_MOVE;
+    }
+
+    BookHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_MAGIC, 4);
+    header.version = BOOK_VERSION;
+    header.entries = BOOK_ENTRIES;
+
+    FILE *fp = fopen(outFile, "wb");
+    if (fp == NULL || fwrite(&header, sizeof(header), 1, fp) != 1 ||
+        fwrite(moves, 1, BOOK_ENTRIES, fp) != BOOK_ENTRIES || fclose(fp) != 0) {
+        perror("bookgen: writing book");
+        return 1;
+    }
+    printf("Wrote %d positions to %s (%d missing)\n",
+           BOOK_ENTRIES - unreachable - missing, outFile, missing);
+    return 0;
+}
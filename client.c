@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
@@ -15,6 +16,7 @@
 
 #include "common.h"
 #include "agent.h"
+#include "proto.h"
 
 int port = 31415;
 char *local = "localhost";
@@ -22,66 +24,74 @@ char *host;
 
 int pipe_fd;
 
-FILE *pipe_in_stream;
+ProtoReader client_reader;
 FILE *pipe_out_stream;
 
-char client_buf[256];
+// Set by think_time., moves then go out with the agent's think time in usec.
+int report_think = FALSE;
 
 /*********************************************************/ /*
-    Close the network connection
+    Close the connection
  */
 void client_cleanup() {
     agent_cleanup();
-    fclose(pipe_in_stream);
-    fclose(pipe_out_stream);
-    close(pipe_fd);
+    fclose(pipe_out_stream);  // and pipe_fd with it
+    // Over tcp that was the reader's fd too, only stdin is left open.
+    if (client_reader.fd != pipe_fd) {
+        close(client_reader.fd);
+    }
     exit(0);  // must exit immediately, to avoid "zombie" process
 }
 
 /*********************************************************/ /*
-    Read from pipe input stream to buffer
+    Monotonic clock in usec
  */
-void pipe_read(char *buf) {
-    fflush(pipe_in_stream);
-
-    buf[0] = '\0';
-    if (!fscanf(pipe_in_stream, "%s", buf)) {
-        fprintf(stderr, ":peepoweird:\n");
-    }
+long usec_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
 
-    if (buf[0] == '\0') {
-        client_cleanup();
+/*********************************************************/ /*
+    Write a move, thought about since start, to output stream
+ */
+void client_write_move(int this_move, long start) {
+    if (report_think) {
+        fprintf(pipe_out_stream, "%d %ld\n", this_move, usec_now() - start);
+    } else {
+        fprintf(pipe_out_stream, "%d\n", this_move);
     }
+    fflush(pipe_out_stream);
 }
 
 /*********************************************************/ /*
     Get second move from agent and write it to output stream
  */
 void client_second_move(int board_num, int prev_move) {
+    long start = usec_now();
     int this_move;
     this_move = agent_second_move(board_num, prev_move);
-    fprintf(pipe_out_stream, "%d\n", this_move);
-    fflush(pipe_out_stream);
+    client_write_move(this_move, start);
 }
 
 /*********************************************************/ /*
     Get third move from agent and write it to output stream
  */
 void client_third_move(int board_num, int first_move, int prev_move) {
+    long start = usec_now();
     int this_move;
     this_move = agent_third_move(board_num, first_move, prev_move);
-    fprintf(pipe_out_stream, "%d\n", this_move);
-    fflush(pipe_out_stream);
+    client_write_move(this_move, start);
 }
 
 /*********************************************************/ /*
     Get next move from agent and write it to output stream
  */
 void client_next_move(int prev_move) {
+    long start = usec_now();
     int this_move;
     this_move = agent_next_move(prev_move);
-    fprintf(pipe_out_stream, "%d\n", this_move);
-    fflush(pipe_out_stream);
+    client_write_move(this_move, start);
 }
 
 /*********************************************************/ /*
@@ -125,82 +135,73 @@ int tcpopen() {
 }
 
 /*********************************************************/ /*
-    Determine cause for win, loss or draw
+    Talk the protocol over stdin and stdout, for a harness that
+    starts the agent itself. Anything the agent prints goes to
+    stderr instead
  */
-int get_cause(char *buf) {
-    int cause = TRIPLE;
-    (void)buf;
-    if (strcmp(client_buf, "triple).") == 0) {
-        cause = TRIPLE;
-    } else if (strcmp(client_buf, "timeout).") == 0) {
-        cause = TIMEOUT;
-    } else if (strcmp(client_buf, "illegal_move).") == 0) {
-        cause = ILLEGAL_MOVE;
-    } else if (strcmp(client_buf, "full_board).") == 0) {
-        cause = FULL_BOARD;
+void stdio_open() {
+    pipe_fd = dup(1);
+    if (pipe_fd < 0 || dup2(2, 1) < 0) {
+        perror("cannot redirect stdout ");
+        exit(1);
     }
-    return (cause);
+    protoInit(&client_reader, 0);
 }
 
 /*********************************************************/
 int main(int argc, char **argv) {
-    int player = 0;
-    int result = DRAW;   // WIN, LOSS or DRAW
-    int cause = TRIPLE;  // TRIPLE, TIMEOUT, ILLEGAL_MOVE or FULL_BOARD
-    int board_num, first_move, prev_move;
-    int sd;
-    char ch;
+    ProtoMessage msg;
 
     host = local;  // default
     agent_parse_args(argc, argv);
 
-    sd = tcpopen();  // host,port );
-
-    pipe_fd = sd;
-    pipe_in_stream = fdopen(sd, "r");
-    pipe_out_stream = fdopen(sd, "w");
-
-    client_buf[0] = '\0';
-    pipe_read(client_buf);
+    if (strcmp(host, "-") == 0) {
+        stdio_open();
+    } else {
+        pipe_fd = tcpopen();  // host,port );
+        protoInit(&client_reader, pipe_fd);
+    }
+    pipe_out_stream = fdopen(pipe_fd, "w");
 
     while (TRUE) {
-        if (strcmp(client_buf, "init.") == 0) {
+        switch (protoRead(&client_reader, &msg, -1)) {
+        case MSG_INIT:
             agent_init();
-        } else if (sscanf(client_buf, "start(%c).", &ch) == 1) {
-            player = (ch == 'x') ? 0 : 1;
-            agent_start(player);
-        } else if (sscanf(client_buf, "second_move(%d,%d).", &board_num,
-                          &prev_move) == 2) {
-            client_second_move(board_num, prev_move);
-        } else if (sscanf(client_buf, "third_move(%d,%d,%d).", &board_num,
-                          &first_move, &prev_move) == 3) {
-            client_third_move(board_num, first_move, prev_move);
-        } else if (sscanf(client_buf, "next_move(%d).", &prev_move) == 1) {
-            client_next_move(prev_move);
-        } else if (sscanf(client_buf, "last_move(%d).", &prev_move) == 1) {
-            agent_last_move(prev_move);
-        } else if (strcmp(client_buf, "win(") > 0 &&
-                   strcmp(client_buf, "win)") < 0) {
-            result = WIN;
-            cause = get_cause(client_buf + 4);
-            agent_gameover(result, cause);
-        } else if (strcmp(client_buf, "loss(") > 0 &&
-                   strcmp(client_buf, "loss)") < 0) {
-            result = LOSS;
-            cause = get_cause(client_buf + 5);
-            agent_gameover(result, cause);
-        } else if (strcmp(client_buf, "draw(") > 0 &&
-                   strcmp(client_buf, "draw)") < 0) {
-            result = DRAW;
-            cause = get_cause(client_buf + 5);
-            agent_gameover(result, cause);
-        } else if (strcmp(client_buf, "end") == 0) {
+            break;
+        case MSG_THINK_TIME:
+            report_think = TRUE;
+            break;
+        case MSG_START:
+            agent_start(msg.args[0]);
+            break;
+        case MSG_SECOND_MOVE:
+            client_second_move(msg.args[0], msg.args[1]);
+            break;
+        case MSG_THIRD_MOVE:
+            client_third_move(msg.args[0], msg.args[1], msg.args[2]);
+            break;
+        case MSG_NEXT_MOVE:
+            client_next_move(msg.args[0]);
+            break;
+        case MSG_LAST_MOVE:
+            agent_last_move(msg.args[0]);
+            break;
+        case MSG_WIN:
+            agent_gameover(WIN, msg.args[0]);
+            break;
+        case MSG_LOSS:
+            agent_gameover(LOSS, msg.args[0]);
+            break;
+        case MSG_DRAW:
+            agent_gameover(DRAW, msg.args[0]);
+            break;
+        case MSG_END:
+        case MSG_EOF:
             client_cleanup();
             return 0;
+        default:
+            break;
         }
-
-        client_buf[0] = '\0';
-        pipe_read(client_buf);
     }
 
     return 0;
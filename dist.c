@@ -0,0 +1,345 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "common.h"
+#include "dist.h"
+#include "agent.h"
+#include "proto.h"
+#include "rng.h"
+#include "store.h"
+
+typedef struct worker {
+    int fd;
+    // seq of the request it's working on, 0 when idle.
+    uint32_t busy;
+    // Bytes of reply read so far.
+    size_t got;
+    DistReply reply;
+} Worker;
+
+static Worker workers[DIST_MAX_WORKERS];
+static int numWorkers = 0;
+static uint32_t seq = 0;
+
+static uint32_t nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static int addWorker(int fd) {
+    if (numWorkers == DIST_MAX_WORKERS) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    // Replies are tiny, don't let Nagle sit on them.
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    workers[numWorkers].fd = fd;
+    workers[numWorkers].busy = 0;
+    workers[numWorkers].got = 0;
+    numWorkers++;
+    return 0;
+}
+
+static void dropWorker(Worker *w) {
+    if (verbose) {
+        fprintf(stderr, "dist: lost worker on fd %d\n", w->fd);
+    }
+    close(w->fd);
+    w->fd = -1;
+}
+
+int distWorkers(void) {
+    int live = 0;
+    for (int w = 0; w < numWorkers; w++) {
+        live += workers[w].fd >= 0;
+    }
+    return live;
+}
+
+void distServe(int fd) {
+    DistRequest request;
+    DistReply reply;
+    /* A forked worker shares the coordinator's open file, so flock wouldn't
+     * keep their updates apart, and its warm start would be counted once
+     * per worker in the merged root. The coordinator does the store. */
+    storeClose();
+    while (protoFullIo(fd, &request, sizeof(request), FALSE, -1) == 0) {
+        mctsConfig = request.config;
+        confidence = request.confidence;
+        moveNo = request.moveNo;
+        memset(&reply, 0, sizeof(reply));
+        reply.seq = request.seq;
+        reply.move = run_mcts(&request.state, (Move)request.lastMove,
+                              request.maxMs);
+        reply.iterations = mctsStats.iterations;
+        reply.confidence = confidence;
+        memcpy(reply.visits, mctsStats.rootVisits, sizeof(reply.visits));
+        memcpy(reply.wins, mctsStats.rootWins, sizeof(reply.wins));
+        if (protoFullIo(fd, &reply, sizeof(reply), TRUE, -1) != 0) {
+            break;
+        }
+    }
+}
+
+int distSpawnLocal(int n) {
+    int started = 0;
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < n; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            perror("dist: socketpair");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("dist: fork");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        } else if (pid == 0) {
+            // Don't hold the other workers' sockets open.
+            for (int w = 0; w < numWorkers; w++) {
+                if (workers[w].fd >= 0) {
+                    close(workers[w].fd);
+                }
+            }
+            close(fds[0]);
+            rngSeed(((uint64_t)getpid() << 32) ^ nowMs());
+            distServe(fds[1]);
+            _exit(0);
+        }
+        close(fds[1]);
+        if (addWorker(fds[0]) == 0) {
+            started++;
+        }
+    }
+    return started;
+}
+
+int distConnect(const char *spec) {
+    int fd = -1;
+    if (strncmp(spec, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, spec + 5, sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+            connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        char host[256];
+        const char *colon = strrchr(spec, ':');
+        struct addrinfo hints, *res, *ai;
+        if (colon == NULL || (size_t)(colon - spec) >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, spec, colon - spec);
+        host[colon - spec] = '\0';
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, colon + 1, &hints, &res) != 0) {
+            return -1;
+        }
+        for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+    return addWorker(fd);
+}
+
+/* Read whatever w has sent. Returns 1 when a reply for the current request
+ * is complete, 0 otherwise. */
+static int readReply(Worker *w) {
+    for (;;) {
+        ssize_t r = read(w->fd, (char *)&w->reply + w->got,
+                         sizeof(DistReply) - w->got);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (r <= 0) {
+            dropWorker(w);
+            return 0;
+        }
+        w->got += (size_t)r;
+        if (w->got < sizeof(DistReply)) {
+            continue;
+        }
+        w->got = 0;
+        w->busy = 0;
+        // A late one from an earlier turn just frees the worker up.
+        return w->reply.seq == seq;
+    }
+}
+
+int distSearch(State *state, Move lastMove, uint32_t maxMs) {
+    if (distWorkers() == 0) {
+        return run_mcts(state, lastMove, maxMs);
+    }
+    uint32_t start = nowMs();
+    uint32_t searchMs =
+        maxMs > 2 * DIST_REPLY_MARGIN_MS ? maxMs - DIST_REPLY_MARGIN_MS
+                                         : maxMs / 2;
+    DistRequest request;
+    memset(&request, 0, sizeof(request));
+    // 0 marks an idle worker.
+    if (++seq == 0) {
+        seq = 1;
+    }
+    request.seq = seq;
+    request.maxMs = searchMs;
+    request.lastMove = lastMove;
+    request.moveNo = moveNo;
+    request.confidence = confidence;
+    request.state = *state;
+    request.config = mctsConfig;
+
+    int sent = 0;
+    for (int w = 0; w < numWorkers; w++) {
+        Worker *worker = &workers[w];
+        // Pick up late replies from earlier turns.
+        if (worker->fd >= 0 && worker->busy) {
+            readReply(worker);
+        }
+        // Still on an old request, it can sit this one out.
+        if (worker->fd < 0 || worker->busy) {
+            continue;
+        }
+        if (protoFullIo(worker->fd, &request, sizeof(request), TRUE,
+                        DIST_REPLY_MARGIN_MS) != 0) {
+            dropWorker(worker);
+            continue;
+        }
+        worker->busy = seq;
+        sent++;
+    }
+
+    // Our own share of the search.
+    Move move = run_mcts(state, lastMove, searchMs);
+    if (mctsStats.iterations == 0) {
+        return move;
+    }
+    uint32_t visits[BOARD_SIZE];
+    double wins[BOARD_SIZE];
+    memcpy(visits, mctsStats.rootVisits, sizeof(visits));
+    memcpy(wins, mctsStats.rootWins, sizeof(wins));
+    uint32_t iterations = mctsStats.iterations;
+    // What the workers added, run_mcts already stored our own share.
+    uint32_t workerVisits[BOARD_SIZE] = {0};
+    double workerWins[BOARD_SIZE] = {0.0};
+    int proven = -1;
+    double provenConfidence = 0.0;
+    int replied = 0;
+
+    for (int pending = sent; pending > 0;) {
+        struct pollfd fds[DIST_MAX_WORKERS];
+        int index[DIST_MAX_WORKERS];
+        int n = 0;
+        uint32_t elapsed = nowMs() - start;
+        if (elapsed >= maxMs) {
+            break;
+        }
+        for (int w = 0; w < numWorkers; w++) {
+            if (workers[w].fd >= 0 && workers[w].busy) {
+                fds[n].fd = workers[w].fd;
+                fds[n].events = POLLIN;
+                index[n++] = w;
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        if (poll(fds, n, (int)(maxMs - elapsed)) <= 0) {
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            Worker *worker = &workers[index[i]];
+            uint32_t wasBusy = worker->busy;
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            if (readReply(worker)) {
+                DistReply *reply = &worker->reply;
+                replied++;
+                iterations += reply->iterations;
+                if (reply->iterations == 0) {
+                    proven = reply->move;
+                    provenConfidence = reply->confidence;
+                }
+                for (int m = 0; m < BOARD_SIZE; m++) {
+                    visits[m] += reply->visits[m];
+                    wins[m] += reply->wins[m];
+                    workerVisits[m] += reply->visits[m];
+                    workerWins[m] += reply->wins[m];
+                }
+            }
+            // Answered, or hung up, on this turn's request.
+            if (wasBusy == seq && (worker->busy == 0 || worker->fd < 0)) {
+                pending--;
+            }
+        }
+    }
+
+    int best = move;
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        if (visits[m] > visits[best]) {
+            best = m;
+        }
+    }
+    if (proven >= 0) {
+        best = proven;
+        confidence = provenConfidence;
+    } else if (visits[best] > 0) {
+        confidence = wins[best] / visits[best];
+    }
+    if (replied > 0) {
+        storeUpdate(state, workerVisits, workerWins);
+    }
+    mctsStats.iterations = iterations;
+    mctsStats.elapsedMs = nowMs() - start;
+    memcpy(mctsStats.rootVisits, visits, sizeof(visits));
+    memcpy(mctsStats.rootWins, wins, sizeof(wins));
+    if (verbose) {
+        fprintf(stderr, "T:%d dist Mv: %d replies: %d/%d iters: %u\n", moveNo,
+                best, replied, sent, iterations);
+    }
+    return best;
+}
+
+void distCleanup(void) {
+    for (int w = 0; w < numWorkers; w++) {
+        if (workers[w].fd >= 0) {
+            close(workers[w].fd);
+        }
+    }
+    numWorkers = 0;
+}
@@ -0,0 +1,65 @@
+#ifndef __DIST_H__
+#define __DIST_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Root parallel search over worker processes.
+ *
+ * Every worker runs run_mcts on the same position, as does the coordinator
+ * itself, and the coordinator adds up the root children's visits and wins
+ * and plays the most visited move. Workers are forked on Unix socketpairs
+ * (distSpawnLocal) or reached over TCP or a Unix socket path where searchd
+ * is listening (distConnect). Requests and replies are the structs below,
+ * sent raw, so every host has to run the same build.
+ *
+ * A worker that hasn't answered by the deadline is left out of that turn and
+ * skipped until its late reply has been drained, one that hangs up is
+ * dropped for good. With no workers left distSearch is just run_mcts. */
+
+#define DIST_MAX_WORKERS 64
+// Searches are given this much less than the turn to get the replies back.
+#define DIST_REPLY_MARGIN_MS 15
+
+typedef struct distRequest {
+    uint32_t seq;
+    uint32_t maxMs;
+    int32_t lastMove;
+    int32_t moveNo;
+    double confidence;
+    State state;
+    MctsConfig config;
+} DistRequest;
+
+typedef struct distReply {
+    uint32_t seq;
+    // 0 when the solver answered, move is then proven.
+    uint32_t iterations;
+    int32_t move;
+    double confidence;
+    uint32_t visits[BOARD_SIZE];
+    double wins[BOARD_SIZE];
+} DistReply;
+
+// Fork n workers on socketpairs. Returns how many started.
+int distSpawnLocal(int n);
+/* Connect to searchd at "host:port" or "unix:/path". Returns 0 on success,
+ * -1 on failure. */
+int distConnect(const char *spec);
+// Number of workers still connected.
+int distWorkers(void);
+
+/* Search state with every worker for at most maxMs and return the merged
+ * move. Sets confidence and mctsStats like run_mcts, iterations summed over
+ * the workers that answered. Only the coordinator uses the position store,
+ * the workers' visits go back to it from here. */
+int distSearch(State *state, Move lastMove, uint32_t maxMs);
+
+/* Answer requests on fd until it's closed. Closes the position store
+ * first, a forked worker would otherwise share the coordinator's flock. */
+void distServe(int fd);
+// Hang up on every worker, local ones exit when they see it.
+void distCleanup(void);
+
+#endif
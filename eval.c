@@ -0,0 +1,70 @@
+#include <math.h>
+
+#include "eval.h"
+
+static const uint32_t lines[8] = {ROW0, ROW1, ROW2, COL0,
+                                  COL1, COL2, DIA0, DIA1};
+static const int lineWeights[4] = {0, EVAL_ONE, EVAL_TWO, 0};
+
+int evalState(State *state, int player) {
+    int score = 0;
+    uint32_t shift = 9u * (player - 1);
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        uint32_t own = (state->board[b] >> shift) & ALL_CIRCLES_MASK;
+        uint32_t opp = (state->board[b] >> (9u - shift)) & ALL_CIRCLES_MASK;
+        for (int l = 0; l < 8; l++) {
+            int o = __builtin_popcount(own & lines[l]);
+            int x = __builtin_popcount(opp & lines[l]);
+            if (x == 0) {
+                score += lineWeights[o];
+            } else if (o == 0) {
+                score -= lineWeights[x];
+            }
+        }
+    }
+    return score;
+}
+
+double evalWinRate(State *state, double scale, double reach) {
+    int player = 3 - state->playerLastMoved;
+    int opponent = state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+    uint32_t empty = ~(board | (board >> 9u)) & ALL_CIRCLES_MASK;
+    uint32_t ourMark = player == CIRCLE_PLAYER ? CIRCLE_PLAYER_START
+                                               : CROSS_PLAYER_START;
+
+    if (stateThreats(board, player)) {
+        return 1.0;
+    }
+    uint32_t m;
+    for (m = empty; m; m &= m - 1) {
+        int sq = __builtin_ctz(m);
+        uint32_t dest = sq == state->subBoard ? board | (ourMark << sq)
+                                              : state->board[sq];
+        if (!stateThreats(dest, opponent)) {
+            break;
+        }
+    }
+    if (m == 0) {
+        return 0.0;
+    }
+
+    // Squares still empty on each sub-board, a square sends play to its board.
+    uint32_t open[BOARD_SIZE];
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        open[b] = ~(state->board[b] | (state->board[b] >> 9u)) &
+                  ALL_CIRCLES_MASK;
+    }
+    double score = 0.0;
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        int ways = 0;
+        for (int i = 0; i < BOARD_SIZE; i++) {
+            ways += (open[i] >> b) & 1u;
+        }
+        uint32_t ours = stateThreats(state->board[b], player);
+        uint32_t theirs = stateThreats(state->board[b], opponent);
+        score += (__builtin_popcount(ours) - __builtin_popcount(theirs)) *
+                 (1.0 + reach * ways / BOARD_SIZE);
+    }
+    return 1.0 / (1.0 + exp(-score / scale));
+}
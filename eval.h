@@ -0,0 +1,24 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include "mcts.h"
+
+/* Static evaluation of a position for the alpha-beta engine. Every line on
+ * every sub-board that only one side has played on is worth EVAL_ONE or
+ * EVAL_TWO to that side, by how many of the line's squares they hold. */
+#define EVAL_ONE 1
+#define EVAL_TWO 3
+
+// Score of state from player's point of view, positive is good for player.
+int evalState(State *state, int player);
+
+/* Chance that the player to move wins, for cutting playouts short. Certain
+ * when they can finish a line now or every move sends the opponent to a
+ * sub-board the opponent can finish. Otherwise each side's open two-in-a-rows
+ * (squares that would complete a line) count on every sub-board, weighted by
+ * 1 + reach * (how many sub-boards still have that square empty) / 9, since
+ * a board nobody can be sent to again doesn't matter. The difference goes
+ * through a logistic with the given scale. */
+double evalWinRate(State *state, double scale, double reach);
+
+#endif
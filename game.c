@@ -65,57 +65,3 @@ void print_board(
   fprintf( fp, "\n" );
   board[board_num][prev_move] -= 3; // lower case
 }
-
-/*********************************************************
-   Return TRUE if the game has been won on this sub-board
-*/
-int gamewon( int p, int bb[10] )
-{
-  return(  ( bb[1] == p && bb[2] == p && bb[3] == p )
-         ||( bb[4] == p && bb[5] == p && bb[6] == p )
-         ||( bb[7] == p && bb[8] == p && bb[9] == p )
-         ||( bb[1] == p && bb[4] == p && bb[7] == p )
-         ||( bb[2] == p && bb[5] == p && bb[8] == p )
-         ||( bb[3] == p && bb[6] == p && bb[9] == p )
-         ||( bb[1] == p && bb[5] == p && bb[9] == p )
-         ||( bb[3] == p && bb[5] == p && bb[7] == p ));
-}
-
-/*********************************************************
-   Return TRUE if this sub-board is full
-*/
-int full_board( int bb[] )
-{
-  int c=1;
-  while( c <= 9 && bb[c] != EMPTY ) {
-    c++;
-  }
-  return( c == 10 );
-}
-
-/*********************************************************
-   Make specified move on board and return game status
-*/
-int make_move(
-              int player,
-              int m,
-              int move[],
-              int board[10][10]
-             )
-{
-  if( board[move[m-1]][move[m]] != EMPTY ) {
-    printf("ILLEGAL MOVE detected on board %d. Move was %d\n", move[m-1], move[m]);
-    print_board(stdout, board, move[m-2], move[m-1]);
-    return( ILLEGAL_MOVE );
-  }
-  board[move[m-1]][move[m]] = player;
-
-  if( gamewon( player,board[move[m-1]] )) {
-    return( WIN );
-  }
-  if( full_board( board[move[m]] )) {
-    return( DRAW );
-  }
-
-  return STILL_PLAYING;
-}
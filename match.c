@@ -0,0 +1,313 @@
+/* Sequential A/B match runner.
+ *
+ * Plays two search settings against each other in process, game pairs over
+ * the same random opening with the sides swapped, on one worker process per
+ * core. Keeps W/D/L and an Elo estimate with a 95% interval, and stops as
+ * soon as a sequential probability ratio test decides between H0: the
+ * difference is elo0 and H1: it is elo1, rather than always playing the 486
+ * games of test.py. The two games of a pair share an opening so aren't
+ * independent, the statistics are over pairs instead, scored 0, 1/4, ... 1
+ * (the pentanomial model). The LLR uses the usual normal approximation of
+ * the pair score, accepting H1 at log((1 - beta) / alpha) and H0 at
+ * log(beta / (1 - alpha)). Results are counted in pair order whichever
+ * worker finishes first, so a run at a fixed number of iterations stops at
+ * the same pair every time.
+ *
+ * Example, does b gain 10 Elo over a at 50ms a move:
+ * ./match -a playout_depth=0 -b playout_depth=2 -t 50 -e 0,10
+ *
+ * Or reproducibly at a fixed number of iterations a move:
+ * ./match -b rave=1 -i 20000 -g 2000 -r 3
+ */
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "rng.h"
+
+#define DEFAULT_MATCH_MS 100
+#define DEFAULT_MATCH_GAMES 20000
+#define DEFAULT_ELO0 0.0
+#define DEFAULT_ELO1 10.0
+#define DEFAULT_SPRT_ERROR 0.05
+#define MAX_MATCH_WORKERS 256
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+// What a worker sends back per game pair, small enough to write atomically.
+typedef struct pairResult {
+    uint32_t pair;
+    // Winner of each game from a's point of view: 1 win, 0 draw, -1 loss.
+    int8_t score[2];
+} PairResult;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-a name=value,...]\n");  // first config
+    printf("       [-b name=value,...]\n");  // second config, under test
+    printf("       [-t ms]\n");              // per move
+    printf("       [-i iterations]\n");      // per move instead of -t
+    printf("       [-g games]\n");           // most games to play
+    printf("       [-e elo0,elo1]\n");       // SPRT hypotheses, b vs a
+    printf("       [-p alpha,beta]\n");      // SPRT error rates
+    printf("       [-j workers]\n");
+    mctsModelUsage();
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+/* Plays pairs worker, worker + numWorkers, ... until killed. Each pair is
+ * seeded from its number, so with -i the games don't depend on which worker
+ * plays them. */
+static void matchWorker(int fd, int worker, int numWorkers, MctsConfig *a,
+                        MctsConfig *b, uint32_t ms, uint64_t seed) {
+    for (uint32_t pair = worker;; pair += numWorkers) {
+        PairResult result = {.pair = pair};
+        rngSeed(seed + pair);
+        int board = rngNext() % 9;
+        int square = rngNext() % 9;
+        for (int g = 0; g < 2; g++) {
+            // a plays X first then O.
+            int aPlayer = g == 0 ? CROSS_PLAYER : CIRCLE_PLAYER;
+            int winner = g == 0 ? mctsPlayGame(a, b, board, square, ms)
+                                : mctsPlayGame(b, a, board, square, ms);
+            result.score[g] = winner == 0 ? 0 : winner == aPlayer ? 1 : -1;
+        }
+        if (write(fd, &result, sizeof(result)) != sizeof(result)) {
+            _exit(1);
+        }
+    }
+}
+
+static double eloFromScore(double score) {
+    if (score <= 0.0) {
+        return -INFINITY;
+    } else if (score >= 1.0) {
+        return INFINITY;
+    }
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static double scoreFromElo(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+/* Mean and variance of the pair score, from b's point of view, given the
+ * number of pairs that scored k / 4 in pairs[k]. Returns the number of
+ * pairs. */
+static int pairStats(const int pairs[5], double *score, double *var) {
+    int n = 0;
+    double sum = 0.0;
+    for (int k = 0; k < 5; k++) {
+        n += pairs[k];
+        sum += pairs[k] * k / 4.0;
+    }
+    *score = n ? sum / n : 0.5;
+    *var = 0.0;
+    for (int k = 0; n && k < 5; k++) {
+        *var += pairs[k] * (k / 4.0 - *score) * (k / 4.0 - *score) / n;
+    }
+    return n;
+}
+
+/* Log likelihood ratio of H1 over H0 after these pairs, with elo0 and elo1
+ * the Elo difference under each. */
+static double sprtLlr(const int pairs[5], double elo0, double elo1) {
+    double score, var;
+    int n = pairStats(pairs, &score, &var);
+    // Nothing to go on while every pair has ended the same way.
+    if (var == 0.0) {
+        return 0.0;
+    }
+    double s0 = scoreFromElo(elo0);
+    double s1 = scoreFromElo(elo1);
+    return n * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * var);
+}
+
+// Elo of the score and the 95% interval around it, as (low, high).
+static double eloInterval(const int pairs[5], double *low, double *high) {
+    double score, var;
+    int n = pairStats(pairs, &score, &var);
+    double margin = 1.96 * sqrt(var / n);
+    *low = eloFromScore(score - margin);
+    *high = eloFromScore(score + margin);
+    return eloFromScore(score);
+}
+
+int main(int argc, char *argv[]) {
+    MctsConfig configs[2] = {mctsConfig, mctsConfig};
+    int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int maxGames = DEFAULT_MATCH_GAMES;
+    uint32_t ms = DEFAULT_MATCH_MS;
+    double elo0 = DEFAULT_ELO0, elo1 = DEFAULT_ELO1;
+    double alpha = DEFAULT_SPRT_ERROR, beta = DEFAULT_SPRT_ERROR;
+    char *policyFile = NULL;
+    char *netFile = NULL;
+    unsigned int seed = 1;
+    int i = 1;
+
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-a") == 0) {
+            if (mctsConfigParse(&configs[0], argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-b") == 0) {
+            if (mctsConfigParse(&configs[1], argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-t") == 0) {
+            ms = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            if (maxIterations < 1) {
+                usage(argv[0]);
+            }
+            fixedBudget = TRUE;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            maxGames = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-e") == 0) {
+            if (sscanf(argv[i + 1], "%lf,%lf", &elo0, &elo1) != 2 ||
+                elo0 >= elo1) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-p") == 0) {
+            if (sscanf(argv[i + 1], "%lf,%lf", &alpha, &beta) != 2 ||
+                alpha <= 0.0 || beta <= 0.0 || alpha + beta >= 1.0) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-j") == 0) {
+            numWorkers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-w") == 0) {
+            policyFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            netFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (numWorkers < 1) {
+        numWorkers = 1;
+    } else if (numWorkers > MAX_MATCH_WORKERS) {
+        numWorkers = MAX_MATCH_WORKERS;
+    }
+    if (mctsLoadModels(policyFile, netFile) != 0) {
+        return 1;
+    }
+    // Fixed time per move, no turn shortening.
+    configs[0].adaptiveTime = FALSE;
+    configs[1].adaptiveTime = FALSE;
+    if (fixedBudget) {
+        ms = UINT32_MAX;
+    }
+
+    for (int c = 0; c < 2; c++) {
+        printf("%c: ", 'a' + c);
+        mctsConfigPrint(stdout, &configs[c]);
+    }
+    printf("sprt elo0 %.1lf elo1 %.1lf alpha %.3lf beta %.3lf, %d workers\n",
+           elo0, elo1, alpha, beta, numWorkers);
+    fflush(stdout);
+
+    int fds[2];
+    pid_t pids[MAX_MATCH_WORKERS];
+    if (pipe(fds) != 0) {
+        perror("match: pipe");
+        return 1;
+    }
+    for (int w = 0; w < numWorkers; w++) {
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("match: fork");
+            return 1;
+        } else if (pids[w] == 0) {
+            close(fds[0]);
+            matchWorker(fds[1], w, numWorkers, &configs[0], &configs[1], ms,
+                        seed);
+            _exit(0);
+        }
+    }
+    close(fds[1]);
+
+    /* From b's point of view, b is the change being tested. Results that
+     * come in ahead of an unfinished pair wait in done until it's in. */
+    int maxPairs = maxGames > 0 ? (maxGames + 1) / 2 : 0;
+    PairResult *done = calloc(maxPairs + 1, sizeof(PairResult));
+    uint8_t *have = calloc(maxPairs + 1, 1);
+    if (done == NULL || have == NULL) {
+        perror("match: calloc");
+        return 1;
+    }
+    int wins = 0, draws = 0, losses = 0;
+    int pairs[5] = {0};
+    double lower = log(beta / (1.0 - alpha));
+    double upper = log((1.0 - beta) / alpha);
+    double llr = 0.0;
+    int next = 0;
+    PairResult result;
+    while (next < maxPairs && llr > lower && llr < upper) {
+        if (!have[next]) {
+            if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+                break;
+            }
+            if (result.pair < (uint32_t)maxPairs) {
+                done[result.pair] = result;
+                have[result.pair] = TRUE;
+            }
+            continue;
+        }
+        int k = 0;
+        for (int g = 0; g < 2; g++) {
+            int8_t score = done[next].score[g];
+            wins += score < 0;
+            draws += score == 0;
+            losses += score > 0;
+            k += 1 - score;
+        }
+        pairs[k]++;
+        next++;
+        llr = sprtLlr(pairs, elo0, elo1);
+        fprintf(stderr, "\rb vs a W/D/L: %d/%d/%d llr: %.2lf (%.2lf, %.2lf) ",
+                wins, draws, losses, llr, lower, upper);
+    }
+    free(done);
+    free(have);
+    fprintf(stderr, "\n");
+    for (int w = 0; w < numWorkers; w++) {
+        kill(pids[w], SIGTERM);
+    }
+    while (wait(NULL) > 0) {
+    }
+    close(fds[0]);
+
+    int games = wins + draws + losses;
+    if (games == 0) {
+        fprintf(stderr, "match: no games finished\n");
+        return 1;
+    }
+    double low, high;
+    double elo = eloInterval(pairs, &low, &high);
+    printf("b vs a W/D/L: %d/%d/%d games: %d elo: %+.1lf [%+.1lf, %+.1lf]\n",
+           wins, draws, losses, games, elo, low, high);
+    printf("b pairs scoring 0/0.5/1/1.5/2: %d/%d/%d/%d/%d\n", pairs[0],
+           pairs[1], pairs[2], pairs[3], pairs[4]);
+    printf("llr %.2lf (%.2lf, %.2lf): %s\n", llr, lower, upper,
+           llr >= upper   ? "H1 accepted"
+           : llr <= lower ? "H0 accepted"
+                          : "inconclusive");
+    return 0;
+}
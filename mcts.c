@@ -1,4 +1,5 @@
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,42 +7,266 @@
 #include <sys/time.h>
 
 #include "mcts.h"
-#include "game.h"
 #include "agent.h"
+#include "perf.h"
+#include "solver.h"
+#include "symmetry.h"
+#include "policy.h"
+#include "nn.h"
+#include "eval.h"
+#include "store.h"
+#include "analysis.h"
+#include "rng.h"
 
 #define TRUE 1
 #define FALSE 0
 
 static Node *newNode(State *state, Move move, Node *parent);
+/* Score each untried move from bitboard features, fill in node->priors and
+ * sort untriedMoves best first. */
+static void nodeComputePriors(Node *node, State *state);
 /* Update this node - one additional visit and result additional wins. result
  * must be from the viewpoint of playerJustmoved. */
 static void nodeUpdate(Node *node, double result);
 /* Use the UCB1 formula to select a child node.
  * ref: https://homes.di.unimi.it/~cesabian/Pubblicazioni/ml-02.pdf
- * We use the UCB1-tuned algorithm linked above but with min{1/4,Vj(nj)}
- * simplified to 1/4.*/
+ * We use the UCB1-tuned algorithm linked above, with min{1/4,Vj(nj)}
+ * simplified to 1/4 unless MctsConfig.ucbTuned is on.*/
 static Node *nodeSelectChild(Node *node);
 /* Remove m from untriedMoves and add a new child node for this move. Return the
  * added child node */
 static Node *nodeAddChild(Node *node, Move move, State *state);
+/* Backpropagate result with AMAF updates. leaf is the state before the
+ * playout and end the state after it. */
+static void nodeUpdateRave(Node *node, State *leaf, State *end,
+                           double winState[3]);
+/* Set node->priors from a network policy and sort untriedMoves best first. */
+static void nodeSetPriors(Node *node, float policy[BOARD_SIZE]);
+/* Evaluate the queued leaves with the network and back up their values. The
+ * visits were already counted when they were queued. */
+static void nodeFlushBatch(Node **nodes, State *states, int n);
+/* Add root children carrying stored visits and wins, scaled down to at most
+ * mctsConfig.storeWarm visits between them. visits and wins come back as
+ * what was actually added. */
+static void nodeWarmStart(Node *root, State *state,
+                          uint32_t visits[BOARD_SIZE],
+                          double wins[BOARD_SIZE]);
+
+/* Play state out and return the result for the player who last moved, a
+ * win probability if the playout was cut short. */
+static double statePlayout(State *state);
+/* Pick one of moves for the player to move, looking depth plies ahead for
+ * lines that can be completed (see MctsConfig.playoutDepth). */
+static Move stateTacticalMove(State *state, int depth, Move *moves,
+                              uint32_t nMoves);
+
+/* Nodes are handed out in order from a per thread arena of chunks and all
+ * taken back at once when the search is done, instead of a calloc and a
+ * free each. The chunks are kept for the next search. */
+#define ARENA_CHUNK_NODES 8192
+
+typedef struct nodeChunk {
+    struct nodeChunk *next;
+    Node nodes[ARENA_CHUNK_NODES];
+} NodeChunk;
+
+static __thread NodeChunk *arenaChunks = NULL;
+// The chunk nodes are coming from, NULL when the arena is empty.
+static __thread NodeChunk *arenaChunk = NULL;
+static __thread uint32_t arenaUsed = 0;
+
+__thread double confidence = 0.5;
+__thread uint32_t maxIterations = MAXITER;
+__thread int fixedBudget = FALSE;
+
+__thread MctsConfig mctsConfig = {
+    .playoutDepth = 0,
+    .expandDepth = 0,
+    .adaptiveTime = TRUE,
+    .confidentHigh = 0.8,
+    .confidentLow = 0.3,
+    .firstTurnMs = FIRST_TURN_TIME,
+    .fastTurnMs = FAST_TARGET_TURN_TIME,
+    .maxTurnMs = MAX_TARGET_TURN_TIME,
+    .endTurnMs = END_GAME_TURN_TIME,
+    .rave = FALSE,
+    .raveK = 1000,
+    .ucbC = 1.0,
+    .ucbVariance = 0.25,
+    .ucbTuned = FALSE,
+    .priors = FALSE,
+    .puctC = 1.0,
+    .rolloutPolicy = FALSE,
+    .network = FALSE,
+    .playoutCutoff = 0,
+    .evalScale = 2.0,
+    .evalReach = 1.0,
+    .storeWarm = 1000,
+};
+__thread MctsStats mctsStats;
+
+static const struct configKey {
+    const char *name;
+    size_t offset;
+    int isDouble;
+} configKeys[] = {
+    {"playout_depth", offsetof(MctsConfig, playoutDepth), FALSE},
+    {"expand_depth", offsetof(MctsConfig, expandDepth), FALSE},
+    {"adaptive_time", offsetof(MctsConfig, adaptiveTime), FALSE},
+    {"confident_high", offsetof(MctsConfig, confidentHigh), TRUE},
+    {"confident_low", offsetof(MctsConfig, confidentLow), TRUE},
+    {"first_turn_ms", offsetof(MctsConfig, firstTurnMs), FALSE},
+    {"fast_turn_ms", offsetof(MctsConfig, fastTurnMs), FALSE},
+    {"max_turn_ms", offsetof(MctsConfig, maxTurnMs), FALSE},
+    {"end_turn_ms", offsetof(MctsConfig, endTurnMs), FALSE},
+    {"rave", offsetof(MctsConfig, rave), FALSE},
+    {"rave_k", offsetof(MctsConfig, raveK), FALSE},
+    {"ucb_c", offsetof(MctsConfig, ucbC), TRUE},
+    {"ucb_variance", offsetof(MctsConfig, ucbVariance), TRUE},
+    {"ucb_tuned", offsetof(MctsConfig, ucbTuned), FALSE},
+    {"priors", offsetof(MctsConfig, priors), FALSE},
+    {"puct_c", offsetof(MctsConfig, puctC), TRUE},
+    {"rollout_policy", offsetof(MctsConfig, rolloutPolicy), FALSE},
+    {"network", offsetof(MctsConfig, network), FALSE},
+    {"playout_cutoff", offsetof(MctsConfig, playoutCutoff), FALSE},
+    {"eval_scale", offsetof(MctsConfig, evalScale), TRUE},
+    {"eval_reach", offsetof(MctsConfig, evalReach), TRUE},
+    {"store_warm", offsetof(MctsConfig, storeWarm), FALSE},
+};
+#define NUM_CONFIG_KEYS (sizeof(configKeys) / sizeof(configKeys[0]))
+
+static const struct configKey *findConfigKey(const char *name) {
+    for (size_t k = 0; k < NUM_CONFIG_KEYS; k++) {
+        if (strcmp(name, configKeys[k].name) == 0) {
+            return &configKeys[k];
+        }
+    }
+    return NULL;
+}
 
-static uint32_t isBoardFull(uint32_t board);
-static uint32_t isGameWon(uint32_t board, uint32_t p);
-static void stateGetMoves(State *state, Move moves[BOARD_SIZE],
-                          uint32_t *numMoves);
-static void statePlayout(State *state);
-static double stateResult(State *state, int player, int prevBoard);
+int mctsConfigParse(MctsConfig *config, const char *spec) {
+    char buf[1024];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
 
-double ucb_const;
-double confidence = 0.5;
+    for (char *tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if (eq == NULL) {
+            return -1;
+        }
+        *eq = '\0';
+        const struct configKey *key = findConfigKey(tok);
+        if (key == NULL) {
+            return -1;
+        }
+        char *field = (char *)config + key->offset;
+        if (key->isDouble) {
+            *(double *)field = atof(eq + 1);
+        } else {
+            *(int *)field = atoi(eq + 1);
+        }
+    }
+    return 0;
+}
 
-/* Could possibly free the tree during the opponent's turn to save a small
- * amount of time.*/
-static void freeTree(Node *node) {
-    for (int i = 0; i < BOARD_SIZE && node->children[i] != NULL; i++) {
-        freeTree(node->children[i]);
+int mctsConfigSet(MctsConfig *config, const char *name, double value) {
+    const struct configKey *key = findConfigKey(name);
+    if (key == NULL) {
+        return -1;
     }
-    free(node);
+    char *field = (char *)config + key->offset;
+    if (key->isDouble) {
+        *(double *)field = value;
+    } else {
+        *(int *)field = (int)lround(value);
+    }
+    return 0;
+}
+
+int mctsConfigGet(MctsConfig *config, const char *name, double *value) {
+    const struct configKey *key = findConfigKey(name);
+    if (key == NULL) {
+        return -1;
+    }
+    char *field = (char *)config + key->offset;
+    *value = key->isDouble ? *(double *)field : *(int *)field;
+    return 0;
+}
+
+void mctsConfigPrint(FILE *fp, MctsConfig *config) {
+    for (size_t k = 0; k < NUM_CONFIG_KEYS; k++) {
+        char *field = (char *)config + configKeys[k].offset;
+        fprintf(fp, "%s%s=", k ? "," : "", configKeys[k].name);
+        if (configKeys[k].isDouble) {
+            fprintf(fp, "%g", *(double *)field);
+        } else {
+            fprintf(fp, "%d", *(int *)field);
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+int mctsLoadModels(const char *policyFile, const char *netFile) {
+    int status = 0;
+    // Missing weights leave the rollout policy uniform.
+    if (policyLoad(policyFile ? policyFile : DEFAULT_POLICY_FILE) != 0 &&
+        policyFile) {
+        fprintf(stderr, "Couldn't load rollout policy %s\n", policyFile);
+        status = -1;
+    }
+    // Only used with -c network=1, all zero weights make it a coin flip.
+    if (nnLoad(netFile ? netFile : DEFAULT_NN_FILE) != 0 && netFile) {
+        fprintf(stderr, "Couldn't load network %s\n", netFile);
+        status = -1;
+    }
+    return status;
+}
+
+void mctsModelUsage(void) {
+    printf("       [-w policy_file]\n");      // rollout policy weights
+    printf("       [-m network_file]\n");     // value/policy network
+}
+
+static Node *arenaAlloc(void) {
+    if (arenaChunk == NULL || arenaUsed == ARENA_CHUNK_NODES) {
+        NodeChunk *next = arenaChunk ? arenaChunk->next : arenaChunks;
+        if (next == NULL) {
+            next = malloc(sizeof(NodeChunk));
+            next->next = NULL;
+            if (arenaChunk) {
+                arenaChunk->next = next;
+            } else {
+                arenaChunks = next;
+            }
+        }
+        arenaChunk = next;
+        arenaUsed = 0;
+    }
+    Node *node = &arenaChunk->nodes[arenaUsed++];
+    memset(node, 0, sizeof(Node));
+    return node;
+}
+
+// Every node goes back at once, the chunks stay for the next search.
+static void arenaReset(void) {
+    arenaChunk = NULL;
+    arenaUsed = 0;
+}
+
+void mctsArenaFree(void) {
+    while (arenaChunks != NULL) {
+        NodeChunk *next = arenaChunks->next;
+        free(arenaChunks);
+        arenaChunks = next;
+    }
+    arenaReset();
+}
+
+static uint32_t elapsedMs(struct timeval *start) {
+    struct timeval curtime;
+    gettimeofday(&curtime, NULL);
+    return (curtime.tv_sec - start->tv_sec) * 1000 +
+           (curtime.tv_usec - start->tv_usec) / 1000;
 }
 
 static Node *mostVisitedChild(Node *node) {
@@ -49,7 +274,7 @@ static Node *mostVisitedChild(Node *node) {
     uint32_t highestVisited = 0;
     uint32_t i;
 
-    for (i = 0; node->children[i] != NULL && i < BOARD_SIZE; i++) {
+    for (i = 0; i < BOARD_SIZE && node->children[i] != NULL; i++) {
         if (node->children[i]->visits > highestVisited) {
             highestVisited = node->children[i]->visits;
             highestNode = node->children[i];
@@ -59,28 +284,111 @@ static Node *mostVisitedChild(Node *node) {
     return highestNode;
 }
 
+int mctsShortTurn(void) {
+    return mctsConfig.adaptiveTime && (confidence > mctsConfig.confidentHigh ||
+                                       confidence < mctsConfig.confidentLow);
+}
+
 int run_mcts(State *rootState, Move lastMove, uint32_t maxMs) {
     uint32_t i;
-    Node *root = newNode(rootState, lastMove, NULL);
-    State *state = calloc(1, sizeof(State));
 
-    // If we're quite sure that we're going to lose/win, reduce the turn time.
-    if (confidence > 0.8 || confidence < 0.3) {
-        maxMs = END_GAME_TURN_TIME;
+    symmetryInit();
+    if (mctsConfig.rolloutPolicy) {
+        policyInit();
     }
 
-    struct timeval start, curtime;
+    /* If we're quite sure that we're going to lose/win, reduce the turn
+     * time. Never lengthen it, a caller like distSearch plans around maxMs. */
+    if (mctsShortTurn() && maxMs > (uint32_t)mctsConfig.endTurnMs) {
+        maxMs = mctsConfig.endTurnMs;
+    }
+    solverMaxNodes = 0;
+    if (fixedBudget) {
+        maxMs = UINT32_MAX;
+        solverMaxNodes = SOLVER_FIXED_NODES;
+    }
+
+    struct timeval start;
     gettimeofday(&start, NULL);
 
-    for (i = 0; i < MAXITER; i++) {
-        // Do a time check every 25000 iterations.
-        if ((i % 25000u) == 0) {
-            gettimeofday(&curtime, NULL);
-            uint32_t curMs = (curtime.tv_sec - start.tv_sec) * 1000 +
-                             (curtime.tv_usec - start.tv_usec) / 1000;
-            if (curMs > maxMs) {
+    /* Close to the end the tree is small enough to solve outright. A proven
+     * loss still goes to the search, it'll at least pick the move that makes
+     * the opponent work hardest for it. */
+    if (stateEmptySquares(rootState) <= SOLVER_MAX_EMPTY) {
+        SolverResult solved;
+        if (fixedBudget) {
+            solverClear();
+        }
+        if (solveState(rootState, maxMs / SOLVER_TIME_DIVISOR, &solved) &&
+            solved.outcome != SOLVER_LOSS) {
+            confidence = solved.outcome == SOLVER_WIN ? GAME_WON : GAME_DRAWN;
+            mctsStats.iterations = 0;
+            mctsStats.elapsedMs = elapsedMs(&start);
+            mctsStats.settledIterations = 0;
+            mctsStats.settledMs = 0;
+            memset(mctsStats.rootVisits, 0, sizeof(mctsStats.rootVisits));
+            memset(mctsStats.rootWins, 0, sizeof(mctsStats.rootWins));
+            if (verbose) {
+                fprintf(stderr, "T:%d solved Mv: %d outcome: %d nodes: %lu\n",
+                        moveNo, solved.move, solved.outcome,
+                        (unsigned long)solved.nodes);
+            }
+            return solved.move;
+        } else if (verbose) {
+            fprintf(stderr, "T:%d solver %s nodes: %lu\n", moveNo,
+                    solved.solved ? "proved a loss" : "ran out of time",
+                    (unsigned long)solved.nodes);
+        }
+    }
+
+    Node *root = newNode(rootState, lastMove, NULL);
+    State *state = calloc(1, sizeof(State));
+    // Where the playout started, only kept for RAVE.
+    State leafState = {0};
+    // Leaves waiting for the network.
+    Node *batchNodes[NN_BATCH];
+    State batchStates[NN_BATCH];
+    int batchSize = 0;
+    if (mctsConfig.network) {
+        float value, policy[BOARD_SIZE];
+        nnEvaluate(rootState, 1, &value, &policy);
+        nodeSetPriors(root, policy);
+    }
+    // What earlier searches of this position left in the store.
+    uint32_t warmVisits[BOARD_SIZE] = {0};
+    double warmWins[BOARD_SIZE] = {0.0};
+    if (storeLookup(rootState, warmVisits, warmWins)) {
+        nodeWarmStart(root, rootState, warmVisits, warmWins);
+    }
+    uint32_t nextAnalysisMs = analysisIntervalMs;
+    Node *settled = NULL;
+    mctsStats.settledIterations = 0;
+    mctsStats.settledMs = 0;
+    perfTurnStart();
+
+    // At least one iteration, so there's a child to play.
+    for (i = 0; i < maxIterations || i == 0; i++) {
+        /* Do a time check every 1024 iterations, often enough not to overrun
+         * the deadline by much when we're sharing the CPU. */
+        if ((i & 1023u) == 0) {
+            uint32_t ms = elapsedMs(&start);
+            if (ms > maxMs && i > 0) {
                 break;
             }
+            Node *best = mostVisitedChild(root);
+            if (best != settled) {
+                settled = best;
+                mctsStats.settledIterations = i;
+                mctsStats.settledMs = ms;
+            }
+            if (analysisEnabled && ms >= nextAnalysisMs) {
+                analysisReport(root, i, ms, FALSE);
+                nextAnalysisMs = ms + analysisIntervalMs;
+            }
+        }
+        int sampled = perfEnabled && (i & PERF_PHASE_SAMPLE_MASK) == 0;
+        if (sampled) {
+            perfPhaseBegin();
         }
         Node *node = root;
         // Restore original state on each iteration.
@@ -91,38 +399,106 @@ int run_mcts(State *rootState, Move lastMove, uint32_t maxMs) {
             node = nodeSelectChild(node);
             stateDoMove(state, node->move);
         }
+        if (sampled) {
+            perfPhaseEnd(PERF_PHASE_SELECT);
+        }
 
         // Expand
         if (state->gameStatus == GAME_NOT_TERMINAL) {
             Move move =
-                node->untriedMoves[(uint32_t)rand() % node->nUntriedMoves];
+                mctsConfig.priors || mctsConfig.network
+                    ? node->untriedMoves[0]
+                : mctsConfig.expandDepth > 0
+                    ? stateTacticalMove(state, mctsConfig.expandDepth,
+                                        node->untriedMoves,
+                                        node->nUntriedMoves)
+                    : node->untriedMoves[rngNext() % node->nUntriedMoves];
             stateDoMove(state, move);
             node = nodeAddChild(node, move, state);
         }
+        if (sampled) {
+            perfPhaseEnd(PERF_PHASE_EXPAND);
+        }
+
+        /* The network's value stands in for the playout. Count the visits now
+         * as a virtual loss so the rest of the batch looks elsewhere. */
+        if (mctsConfig.network && state->gameStatus == GAME_NOT_TERMINAL) {
+            for (Node *n = node; n != NULL; n = n->parent) {
+                n->visits++;
+            }
+            batchNodes[batchSize] = node;
+            batchStates[batchSize++] = *state;
+            if (batchSize == NN_BATCH) {
+                nodeFlushBatch(batchNodes, batchStates, batchSize);
+                batchSize = 0;
+            }
+            if (sampled) {
+                perfPhaseEnd(PERF_PHASE_PLAYOUT);
+            }
+            continue;
+        }
 
         // Playout
-        statePlayout(state);
+        if (mctsConfig.rave) {
+            leafState = *state;
+        }
+        double result = statePlayout(state);
+        if (sampled) {
+            perfPhaseEnd(PERF_PHASE_PLAYOUT);
+        }
 
         // Backpropagate
         double winState[3];
-        winState[state->playerLastMoved] = state->gameStatus;
+        winState[state->playerLastMoved] = result;
         // Optimisation based on the assumption that it's a zero-sum game.
-        winState[3 - state->playerLastMoved] = 1 - state->gameStatus;
-        while (node != NULL) {
-            nodeUpdate(node, winState[node->playerLastMoved]);
-            node = node->parent;
+        winState[3 - state->playerLastMoved] = 1 - result;
+        if (mctsConfig.rave) {
+            nodeUpdateRave(node, &leafState, state, winState);
+        } else {
+            while (node != NULL) {
+                nodeUpdate(node, winState[node->playerLastMoved]);
+                node = node->parent;
+            }
+        }
+        if (sampled) {
+            perfPhaseEnd(PERF_PHASE_BACKPROP);
         }
     }
+    if (batchSize > 0) {
+        nodeFlushBatch(batchNodes, batchStates, batchSize);
+    }
+    perfTurnEnd(moveNo, i);
+    mctsStats.iterations = i;
+    mctsStats.elapsedMs = elapsedMs(&start);
+    memset(mctsStats.rootVisits, 0, sizeof(mctsStats.rootVisits));
+    memset(mctsStats.rootWins, 0, sizeof(mctsStats.rootWins));
+    for (int n = 0; n < BOARD_SIZE && root->children[n] != NULL; n++) {
+        Node *child = root->children[n];
+        mctsStats.rootVisits[child->move] = child->visits;
+        mctsStats.rootWins[child->move] = child->wins;
+    }
     free(state);
+    analysisReport(root, i, mctsStats.elapsedMs, TRUE);
+    // Only what this search added goes back to the store.
+    if (storeEnabled) {
+        uint32_t visits[BOARD_SIZE];
+        double wins[BOARD_SIZE];
+        for (int m = 0; m < BOARD_SIZE; m++) {
+            visits[m] = mctsStats.rootVisits[m] - warmVisits[m];
+            wins[m] = mctsStats.rootWins[m] - warmWins[m];
+        }
+        storeUpdate(rootState, visits, wins);
+    }
     // Return the move that was most visited.
     Node *highestNode = mostVisitedChild(root);
     confidence = highestNode->wins / highestNode->visits;
+    if (highestNode != settled) {
+        mctsStats.settledIterations = i;
+        mctsStats.settledMs = mctsStats.elapsedMs;
+    }
 
     if (verbose) {
-        gettimeofday(&curtime, NULL);
-        uint32_t curMs = (curtime.tv_sec - start.tv_sec) * 1000 +
-                         (curtime.tv_usec - start.tv_usec) / 1000;
-        fprintf(stderr, "[%u]T:%d ", curMs, moveNo);
+        fprintf(stderr, "[%u]T:%d ", mctsStats.elapsedMs, moveNo);
         for (int n = 0; n < BOARD_SIZE && root->children[n] != NULL; n++) {
             fprintf(stderr, "%.2lf ",
                     root->children[n]->wins / root->children[n]->visits);
@@ -134,136 +510,339 @@ int run_mcts(State *rootState, Move lastMove, uint32_t maxMs) {
     }
 
     int ourMove = highestNode->move;
-    freeTree(root);
+    arenaReset();
     return ourMove;
 }
 
-State *initState(int board, int prev_move, int first_move) {
-    State *newState = calloc(1, sizeof(State));
-    newState->gameStatus = GAME_NOT_TERMINAL;
-    newState->subBoard = prev_move;
+static double statePlayout(State *state) {
+    uint32_t nMoves;
+    Move moves[BOARD_SIZE];
+    int depth = mctsConfig.playoutDepth;
+    int policy = mctsConfig.rolloutPolicy;
+    // Counts down to 0 for a cut, never gets there when it's off.
+    int plies = mctsConfig.playoutCutoff > 0 ? mctsConfig.playoutCutoff : -1;
+    while (state->gameStatus == GAME_NOT_TERMINAL) {
+        if (plies-- == 0) {
+            return 1.0 - evalWinRate(state, mctsConfig.evalScale,
+                                     mctsConfig.evalReach);
+        }
+        stateGetMoves(state, moves, &nMoves);
+        if (depth > 0) {
+            stateDoMove(state, stateTacticalMove(state, depth, moves, nMoves));
+        } else if (policy) {
+            stateDoMove(state, policySample(state, moves, nMoves));
+        } else {
+            stateDoMove(state, moves[rngNext() % nMoves]);
+        }
+    }
+    return state->gameStatus;
+}
 
-    if (first_move == -1) {
-        newState->me = CIRCLE_PLAYER;
-        newState->board[board] = CROSS_PLAYER_START << prev_move;
-        newState->playerLastMoved = CROSS_PLAYER;
-    } else {
-        newState->me = CROSS_PLAYER;
-        newState->board[board] = CROSS_PLAYER_START << first_move;
-        newState->board[first_move] |= CIRCLE_PLAYER_START << prev_move;
-        newState->playerLastMoved = CIRCLE_PLAYER;
+static Move stateTacticalMove(State *state, int depth, Move *moves,
+                              uint32_t nMoves) {
+    int player = 3 - state->playerLastMoved;
+    int opponent = state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+    uint32_t candidates = 0;
+    for (uint32_t i = 0; i < nMoves; i++) {
+        candidates |= 1u << moves[i];
     }
 
-    newState->opponent = 3 - newState->me;
-    return newState;
-}
+    // 1 ply: finish a line if we can.
+    uint32_t wins = stateThreats(board, player) & candidates;
+    if (wins) {
+        return __builtin_ctz(wins);
+    }
 
-void stateDoMove(State *state, Move move) {
-    uint32_t moveMaker = 3u - state->playerLastMoved;
-    int prevBoard = state->subBoard;
-    /* In this case, the branching resulting from the ternary operation would
-     * likely produce less latency compared to the bitwise arithmetic approach
-     * commented out as IMUL instructions need to be set up and are as heavy as
-     * a branch instruction itself.*/
-    state->board[state->subBoard] |= moveMaker == CIRCLE_PLAYER
-                                         ? CIRCLE_PLAYER_START << move
-                                         : CROSS_PLAYER_START << move;
-    // |= (CIRCLE_PLAYER_START << 9u * (moveMaker- 1u)) << move;
-    state->subBoard = move;
-    state->playerLastMoved = moveMaker;
-    state->gameStatus = stateResult(state, moveMaker, prevBoard);
-}
+    // 2 ply: don't send them somewhere they can finish a line.
+    uint32_t safe = 0;
+    uint32_t forcing = 0;
+    uint32_t ourMark = player == CIRCLE_PLAYER ? CIRCLE_PLAYER_START
+                                               : CROSS_PLAYER_START;
+    uint32_t theirMark = CIRCLE_PLAYER_START + CROSS_PLAYER_START - ourMark;
+    for (uint32_t i = 0; i < nMoves && depth >= 2; i++) {
+        Move m = moves[i];
+        uint32_t dest = m == state->subBoard ? board | (ourMark << m)
+                                             : state->board[m];
+        if (stateThreats(dest, opponent)) {
+            continue;
+        }
+        safe |= 1u << m;
 
-static void stateGetMoves(State *state, Move moves[BOARD_SIZE],
-                          uint32_t *numMoves) {
-    uint32_t subBoard = state->board[state->subBoard];
-    uint32_t mask = CIRCLE_PLAYER_START + CROSS_PLAYER_START;
-    int n = 0;
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        // If Circle or Cross doesn't have a move in that square...
-        if (!(subBoard & mask)) {
-            moves[n] = i;
-            ++n;
+        // 3 ply: every reply they have sends us to a board we can finish.
+        uint32_t replies = ~(dest | (dest >> 9u)) & ALL_CIRCLES_MASK;
+        if (depth < 3 || replies == 0) {
+            continue;
+        }
+        uint32_t r;
+        for (r = replies; r; r &= r - 1) {
+            int sq = __builtin_ctz(r);
+            uint32_t next = sq == m ? dest | (theirMark << sq)
+                            : sq == state->subBoard
+                                ? board | (ourMark << m)
+                                : state->board[sq];
+            if (!stateThreats(next, player)) {
+                break;
+            }
         }
-        mask = mask << 1;
+        if (r == 0) {
+            forcing |= 1u << m;
+        }
+    }
+
+    uint32_t pool = forcing ? forcing : safe ? safe : candidates;
+    // Uniform pick among the set bits of pool.
+    int n = rngNext() % __builtin_popcount(pool);
+    while (n--) {
+        pool &= pool - 1;
     }
-    *numMoves = n;
+    return __builtin_ctz(pool);
 }
 
-static void statePlayout(State *state) {
-    uint32_t nMoves;
-    Move moves[BOARD_SIZE];
-    while (state->gameStatus == GAME_NOT_TERMINAL) {
-        stateGetMoves(state, moves, &nMoves);
-        stateDoMove(state, moves[(uint32_t)rand() % nMoves]);
+static void nodeUpdate(Node *node, double result) {
+    node->visits++;
+    node->wins += result;
+    node->winsSq += (float)(result * result);
+}
+
+static void nodeUpdateRave(Node *node, State *leaf, State *end,
+                           double winState[3]) {
+    /* played[p][b] holds the squares player p took on sub-board b after the
+     * node we're at. Starts as whatever the playout filled in, then each
+     * tree move gets added on the way up. */
+    uint32_t played[3][BOARD_SIZE];
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        uint32_t added = end->board[b] & ~leaf->board[b];
+        played[CIRCLE_PLAYER][b] = added & ALL_CIRCLES_MASK;
+        played[CROSS_PLAYER][b] = added >> 9u;
+    }
+
+    while (node != NULL) {
+        nodeUpdate(node, winState[node->playerLastMoved]);
+        /* A node's move is also the sub-board its children are played on.
+         * Its children all belong to the player to move there. */
+        for (int i = 0; i < BOARD_SIZE && node->children[i] != NULL; i++) {
+            Node *child = node->children[i];
+            if (played[child->playerLastMoved][node->move] &
+                (1u << child->move)) {
+                child->amafVisits++;
+                child->amafWins += (float)winState[child->playerLastMoved];
+            }
+        }
+        if (node->parent != NULL) {
+            played[node->playerLastMoved][node->parent->move] |= 1u
+                                                                 << node->move;
+        }
+        node = node->parent;
     }
 }
 
-// EVIL BIT LEVEL OPTIMIZATION.
-static uint32_t isBoardFull(uint32_t board) {
-    // Optimize for as little branching as possible.
-    uint32_t circles = board & ALL_CIRCLES_MASK;
-    uint32_t crosses = (board & ALL_CROSSES_MASK) >> 9u;
-    return (circles | crosses) == ALL_CIRCLES_MASK;
+static void nodeSetPriors(Node *node, float policy[BOARD_SIZE]) {
+    // Insertion sort untriedMoves by policy, there are at most 9.
+    for (uint32_t i = 1; i < node->nUntriedMoves; i++) {
+        Move m = node->untriedMoves[i];
+        uint32_t j = i;
+        for (; j > 0 && policy[node->untriedMoves[j - 1]] < policy[m]; j--) {
+            node->untriedMoves[j] = node->untriedMoves[j - 1];
+        }
+        node->untriedMoves[j] = m;
+    }
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        node->priors[m] = (uint8_t)(PRIOR_SCALE * policy[m] + 0.5f);
+    }
 }
 
-// EVIL BIT LEVEL OPTIMIZATION BUT WORSE.
-static uint32_t isGameWon(uint32_t board, uint32_t p) {
-    /* Could alternatively use a tree like approach to this, checking squares
-     * 0, 4, 8, could be more efficient as the worst case branching would be
-     * better.*/
-    --p;
-    board = board >> (9u * p);
-    return ((board & ROW0) == ROW0 || (board & ROW1) == ROW1 ||
-            (board & ROW2) == ROW2 || (board & COL0) == COL0 ||
-            (board & COL1) == COL1 || (board & COL2) == COL2 ||
-            (board & DIA0) == DIA0 || (board & DIA1) == DIA1);
+static void nodeFlushBatch(Node **nodes, State *states, int n) {
+    float values[NN_BATCH];
+    float policies[NN_BATCH][BOARD_SIZE];
+    nnEvaluate(states, n, values, policies);
+    for (int b = 0; b < n; b++) {
+        Node *node = nodes[b];
+        double winState[3];
+        // The value is for the player to move at the leaf.
+        winState[3 - states[b].playerLastMoved] = values[b];
+        winState[states[b].playerLastMoved] = 1.0 - values[b];
+        nodeSetPriors(node, policies[b]);
+        for (; node != NULL; node = node->parent) {
+            double result = winState[node->playerLastMoved];
+            node->wins += result;
+            node->winsSq += (float)(result * result);
+        }
+    }
 }
 
-static void nodeUpdate(Node *node, double result) {
-    node->visits++;
-    node->wins += result;
+static void nodeWarmStart(Node *root, State *state,
+                          uint32_t visits[BOARD_SIZE],
+                          double wins[BOARD_SIZE]) {
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves = root->nUntriedMoves;
+    uint64_t total = 0;
+    // nodeAddChild reshuffles untriedMoves as we go.
+    memcpy(moves, root->untriedMoves, sizeof(moves));
+    for (uint32_t i = 0; i < nMoves; i++) {
+        total += visits[moves[i]];
+    }
+    double scale = total > (uint64_t)mctsConfig.storeWarm
+                       ? (double)mctsConfig.storeWarm / total
+                       : 1.0;
+
+    uint32_t stored[BOARD_SIZE];
+    double storedWins[BOARD_SIZE];
+    memcpy(stored, visits, sizeof(stored));
+    memcpy(storedWins, wins, sizeof(storedWins));
+    memset(visits, 0, BOARD_SIZE * sizeof(uint32_t));
+    memset(wins, 0, BOARD_SIZE * sizeof(double));
+    for (uint32_t i = 0; i < nMoves; i++) {
+        Move m = moves[i];
+        uint32_t n = (uint32_t)(stored[m] * scale + 0.5);
+        if (n == 0) {
+            continue;
+        }
+        State child = *state;
+        stateDoMove(&child, m);
+        Node *node = nodeAddChild(root, m, &child);
+        node->visits = n;
+        node->wins = storedWins[m] * n / stored[m];
+        // The store keeps no variance, take the results as plain wins.
+        node->winsSq = (float)node->wins;
+        root->visits += n;
+        visits[m] = n;
+        wins[m] = node->wins;
+    }
 }
 
 static Node *newNode(State *state, Move move, Node *parent) {
-    Node *node = calloc(1, sizeof(Node));
+    Node *node = arenaAlloc();
     node->parent = parent;
     node->move = move;
     node->playerLastMoved = state->playerLastMoved;
-    // node->children guaranteed NULL'd by calloc
+    // node->children guaranteed NULL'd by arenaAlloc
     // stateGetMoves initializes node->untriedMoves and node->nUntriedMoves.
     stateGetMoves(state, node->untriedMoves, &node->nUntriedMoves);
+
+    /* Near the root, moves that are mirror images of each other lead to the
+     * same subtree so only one of each gets searched. */
+    int depth = 0;
+    for (Node *p = parent; p != NULL && depth < SYMMETRY_MAX_DEPTH;
+         p = p->parent) {
+        depth++;
+    }
+    if (depth < SYMMETRY_MAX_DEPTH) {
+        uint32_t syms = stateSymmetries(state);
+        if (syms) {
+            symmetryPruneMoves(syms, node->untriedMoves, &node->nUntriedMoves);
+        }
+    }
+    if (mctsConfig.priors && !mctsConfig.network &&
+        state->gameStatus == GAME_NOT_TERMINAL) {
+        nodeComputePriors(node, state);
+    }
     node->wins = 0.0;
     node->visits = 0;
 
     return node;
 }
 
-static double stateResult(State *state, int player, int prevBoard) {
-    uint32_t subBoard = state->board[prevBoard];
-
-    if (isBoardFull(subBoard)) {
-        return GAME_DRAWN;
-    } else if (isGameWon(subBoard, player)) {
-        return GAME_WON;
-    } else if (isGameWon(subBoard, 3 - player)) {
-        return GAME_LOST;
+static void nodeComputePriors(Node *node, State *state) {
+    int player = 3 - state->playerLastMoved;
+    int opponent = state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+    uint32_t ourMark = player == CIRCLE_PLAYER ? CIRCLE_PLAYER_START
+                                               : CROSS_PLAYER_START;
+    uint32_t ourWins = stateThreats(board, player);
+    uint32_t theirWins = stateThreats(board, opponent);
+    uint32_t ourThreats = __builtin_popcount(ourWins);
+    float scores[BOARD_SIZE];
+    float total = 0.0f;
+
+    for (uint32_t i = 0; i < node->nUntriedMoves; i++) {
+        Move m = node->untriedMoves[i];
+        uint32_t after = board | (ourMark << m);
+        uint32_t dest = m == state->subBoard ? after : state->board[m];
+        float score = 1.0f;
+
+        if (ourWins & (1u << m)) {
+            score = 100.0f;
+        } else if (stateThreats(dest, opponent)) {
+            // They finish a line next move.
+            score = 0.05f;
+        } else {
+            if (theirWins & (1u << m)) {
+                score += 2.0f;
+            }
+            // New two-in-a-rows we make here.
+            score += (float)__builtin_popcount(stateThreats(after, player)) -
+                     (float)ourThreats;
+            // They have to spend a move blocking us over there.
+            if (stateThreats(dest, player)) {
+                score += 0.5f;
+            }
+            if (isBoardFull(dest)) {
+                score = 0.5f;
+            }
+        }
+        scores[i] = score;
+        total += score;
     }
 
-    return GAME_NOT_TERMINAL;
+    // Insertion sort untriedMoves by score, there are at most 9.
+    for (uint32_t i = 1; i < node->nUntriedMoves; i++) {
+        Move m = node->untriedMoves[i];
+        float score = scores[i];
+        uint32_t j = i;
+        for (; j > 0 && scores[j - 1] < score; j--) {
+            node->untriedMoves[j] = node->untriedMoves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        node->untriedMoves[j] = m;
+        scores[j] = score;
+    }
+    for (uint32_t i = 0; i < node->nUntriedMoves; i++) {
+        node->priors[node->untriedMoves[i]] =
+            (uint8_t)(PRIOR_SCALE * scores[i] / total + 0.5f);
+    }
 }
 
 static Node *nodeSelectChild(Node *node) {
     Node *bestChild = NULL;
     double curUCT;
     double bestUCT = -INFINITY;
-    // 0.25 is the constant we've picked to replace min{1/4,Vj(nj)}.
-    double x = 0.25 * log((double)node->visits);
+    // ucbVariance is the constant we've picked to replace min{1/4,Vj(nj)}.
+    double logN = log((double)node->visits);
+    double x = mctsConfig.ucbVariance * logN;
+    double puct =
+        mctsConfig.puctC * sqrt((double)node->visits) / PRIOR_SCALE;
 
-    for (int i = 0; node->children[i] != NULL && i < BOARD_SIZE; i++) {
+    for (int i = 0; i < BOARD_SIZE && node->children[i] != NULL; i++) {
         Node *curChild = node->children[i];
         curUCT = curChild->wins / (double)curChild->visits;
-        curUCT += sqrt(x / (double)curChild->visits);
+        if (mctsConfig.rave && curChild->amafVisits > 0) {
+            double k = (double)mctsConfig.raveK;
+            double beta = sqrt(k / (3.0 * curChild->visits + k));
+            curUCT = (1.0 - beta) * curUCT +
+                     beta * curChild->amafWins / curChild->amafVisits;
+        }
+        if (mctsConfig.priors || mctsConfig.network) {
+            curUCT += puct * node->priors[curChild->move] /
+                      (1.0 + curChild->visits);
+        } else if (mctsConfig.ucbTuned) {
+            double invN = 1.0 / (double)curChild->visits;
+            double bound = 2.0 * logN * invN;
+            double v = mctsConfig.ucbVariance;
+            /* Selection dominates the iteration, skip the variance and its
+             * square root while the bound alone is over the cap. */
+            if (bound < v * v) {
+                double mean = curChild->wins * invN;
+                double var =
+                    curChild->winsSq * invN - mean * mean + sqrt(bound);
+                if (var < v) {
+                    v = var;
+                }
+            }
+            curUCT += mctsConfig.ucbC * sqrt(v * logN * invN);
+        } else {
+            curUCT += mctsConfig.ucbC * sqrt(x / (double)curChild->visits);
+        }
         if (curUCT > bestUCT) {
             bestUCT = curUCT;
             bestChild = curChild;
@@ -297,25 +876,63 @@ static Node *nodeAddChild(Node *parent, Move move, State *state) {
     return childNode;
 }
 
-void printBoard(State *state) {
-    int board[10][10];
-    int i, j;
-    for (i = 0; i < BOARD_SIZE; i++) {
-        uint32_t c_mask = CIRCLE_PLAYER_START;
-        uint32_t x_mask = CROSS_PLAYER_START;
-        for (j = 0; j < BOARD_SIZE; j++) {
-            if (state->board[i] & c_mask) {
-                board[i + 1][j + 1] = 1;
-            } else if (state->board[i] & x_mask) {
-                board[i + 1][j + 1] = 0;
-            } else {
-                board[i + 1][j + 1] = 2;
+/* Each move a run_mcts under the mover's config and its own confidence, at
+ * ms a move or, with timeScale above 0, on the scaled clock. */
+static int playGame(MctsConfig *cross, MctsConfig *circle, int board,
+                    int square, uint32_t ms, double timeScale) {
+    State *state = initState(board, square, -1);
+    // Like servt, the first move's increment is already in the clock.
+    double startMs =
+        (GAME_CLOCK_INITIAL_MS - GAME_CLOCK_PER_MOVE_MS) * timeScale;
+    double clockMs[2] = {startMs, startMs};
+    double confidences[2] = {0.5, 0.5};
+    int winner = 0;
+    moveNo = 1;
+    while (state->gameStatus == GAME_NOT_TERMINAL) {
+        int mover = 3 - state->playerLastMoved;
+        int side = mover == CROSS_PLAYER;
+        MctsConfig *config = side ? cross : circle;
+        uint32_t turnMs = ms;
+        moveNo++;
+        mctsConfig = *config;
+        if (timeScale > 0.0) {
+            // The agent's schedule, all scaled with the clock.
+            int agentMs = moveNo <= 3   ? config->firstTurnMs
+                          : moveNo <= 9 ? config->fastTurnMs
+                                        : config->maxTurnMs;
+            turnMs = (uint32_t)(agentMs * timeScale);
+            mctsConfig.endTurnMs = (int)(config->endTurnMs * timeScale);
+            clockMs[side] += GAME_CLOCK_PER_MOVE_MS * timeScale;
+        }
+        confidence = confidences[side];
+        Move move = run_mcts(state, state->subBoard, turnMs);
+        confidences[side] = confidence;
+        if (timeScale > 0.0) {
+            clockMs[side] -= 1 + mctsStats.elapsedMs;
+            if (clockMs[side] < 0) {
+                winner = 3 - mover;
+                break;
             }
-            c_mask = c_mask << 1;
-            x_mask = x_mask << 1;
         }
+        stateDoMove(state, move);
     }
-    print_board(stdout, board, 0, 0);
+    if (state->gameStatus == GAME_WON) {
+        winner = state->playerLastMoved;
+    } else if (state->gameStatus == GAME_LOST) {
+        winner = 3 - state->playerLastMoved;
+    }
+    free(state);
+    return winner;
+}
+
+int mctsPlayGame(MctsConfig *cross, MctsConfig *circle, int board,
+                 int square, uint32_t ms) {
+    return playGame(cross, circle, board, square, ms, 0.0);
+}
+
+int mctsPlayTimedGame(MctsConfig *cross, MctsConfig *circle, int board,
+                      int square, double timeScale) {
+    return playGame(cross, circle, board, square, UINT32_MAX, timeScale);
 }
 
 void whiteBoxTests(void) {
@@ -2,12 +2,15 @@
 #define __MCTS_H__
 
 #include <stdint.h>
+#include <stdio.h>
+
+#include "rules.h"
 
 // In the late game, we cap the iterations so we don't spin for too long as the
 // game is pretty much decided at this point.
 #define MAXITER 2000000
 
-// Time controls in ms.
+// Default time controls in ms, see the turn times in MctsConfig.
 // Maximum turn time, used in the mid-game.
 #define MAX_TARGET_TURN_TIME 4200
 // Early game time controls.
@@ -16,47 +19,8 @@
 // Victory or defeat should be obvious at this point.
 #define END_GAME_TURN_TIME 1750
 
-#define EMPTY_SQUARE 0
-#define CIRCLE_PLAYER 1
-#define CROSS_PLAYER 2
-#define BOARD_SIZE 9
-#define GAME_NOT_TERMINAL -1.0
-#define GAME_LOST 0.0
-#define GAME_WON 1.0
-#define GAME_DRAWN 0.5
-
-// Scary bit constants below
-#define CROSS_PLAYER_START 0x00000200
-#define CIRCLE_PLAYER_START 0x00000001
-#define ALL_CIRCLES_MASK 0x000001ff
-// 0x1ff << 9
-#define ALL_CROSSES_MASK 0x0003fe00
-// wtf
-#define ROW0 0x00000007
-#define ROW1 0x00000038
-#define ROW2 0x000001c0
-#define COL0 0x00000049
-#define COL1 0x00000092
-#define COL2 0x00000124
-#define DIA0 0x00000111
-#define DIA1 0x00000054
-
-typedef uint8_t Move;
-
-// Game state.
-typedef struct state {
-    // GAME_NOT_TERMINAL/LOST/WON/DRAWN
-    double gameStatus;
-    // CIRCLE_PLAYER/CROSS_PLAYER
-    int opponent;
-    int me;
-    int playerLastMoved;
-    // Which sub-board the game is currently on.
-    int subBoard;
-    /* Each subboard is divided into 2 9 bit sections. Starting with the least 9
-     * bits for Circle and then the nex 9 for Cross. */
-    uint32_t board[BOARD_SIZE];
-} State;
+// Node priors are stored as fractions of this.
+#define PRIOR_SCALE 255
 
 typedef struct _mctsNode {
     // Root node has NULL for its parent.
@@ -68,18 +32,144 @@ typedef struct _mctsNode {
     Move untriedMoves[BOARD_SIZE];
     // Required to pick a random move.
     uint32_t nUntriedMoves;
+    /* Prior of each move indexed by square, out of PRIOR_SCALE. Only filled
+     * in when MctsConfig.priors is on. */
+    uint8_t priors[BOARD_SIZE];
     double wins;
     uint32_t visits;
+    /* All-moves-as-first statistics: simulations through the parent in which
+     * the player to move there played this move at any later point. */
+    uint32_t amafVisits;
+    float amafWins;
+    /* Sum of squared results, for UCB1-tuned's variance estimate. A float
+     * sits in what was padding, so the node stays the same size, and is
+     * exact for results of 0, 1/2 and 1 up to 2^22 visits. */
+    float winsSq;
 } Node;
 
+/* Runtime search settings. Everything defaults to the original engine, the
+ * agent takes overrides with -c and the bench tool compares two of them. */
+typedef struct mctsConfig {
+    /* Tactical look-ahead used to pick playout moves: 0 uniform random, 1
+     * take immediate wins, 2 also avoid sending the opponent to a sub-board
+     * they can finish, 3 also prefer moves where every reply lets us finish
+     * one. */
+    int playoutDepth;
+    // Same look-ahead for choosing which untried move a node expands first.
+    int expandDepth;
+    /* Cut the turn to at most endTurnMs when confidence is above
+     * confidentHigh or below confidentLow. */
+    int adaptiveTime;
+    double confidentHigh;
+    double confidentLow;
+    /* Agent turn times: moves 2 and 3, the rest up to move 9, after that and
+     * the cut turns of adaptiveTime. */
+    int firstTurnMs;
+    int fastTurnMs;
+    int maxTurnMs;
+    int endTurnMs;
+    // Blend all-moves-as-first statistics into selection.
+    int rave;
+    /* RAVE schedule, AMAF weight is sqrt(k / (3n + k)) for a child with n
+     * visits so it fades out as real statistics come in. */
+    int raveK;
+    /* UCB1-tuned exploration, ucbC * sqrt(ucbVariance * ln N / n), with
+     * ucbVariance standing in for min{1/4, V(n)}. */
+    double ucbC;
+    double ucbVariance;
+    /* Use min{ucbVariance, V(n)} instead, V(n) being the child's variance of
+     * results plus sqrt(2 ln N / n), so low variance moves explore less. Off
+     * by default, at equal time in bench it scored 60/0/60 against the
+     * constant over 120 games at 50ms. */
+    int ucbTuned;
+    /* Heuristic move priors: expand the most promising move first and pick
+     * children with PUCT, Q + puctC * P * sqrt(N) / (1 + n), instead of
+     * UCB1-tuned. */
+    int priors;
+    double puctC;
+    /* Sample playout moves from the pattern tables in policy.c instead of
+     * uniformly. playoutDepth takes precedence when both are set. */
+    int rolloutPolicy;
+    /* Evaluate leaves with the network in nn.c instead of playing them out,
+     * its policy head supplies the priors for PUCT selection. */
+    int network;
+    /* Stop playouts after this many plies, 0 for never, and score the
+     * position with evalWinRate(state, evalScale, evalReach) instead. */
+    int playoutCutoff;
+    double evalScale;
+    double evalReach;
+    /* Most visits the root's children start with from the position store
+     * between them, see store.h. */
+    int storeWarm;
+} MctsConfig;
+
+// Counters from the last run_mcts call.
+typedef struct mctsStats {
+    uint32_t iterations;
+    uint32_t elapsedMs;
+    // Visits of each root child by move, all 0 when the solver answered.
+    uint32_t rootVisits[BOARD_SIZE];
+    // Their wins for the player to move at the root.
+    double rootWins[BOARD_SIZE];
+    /* Iterations and ms into the search when the most visited root child
+     * last changed, checked every 1024 iterations. 0 from the solver. */
+    uint32_t settledIterations;
+    uint32_t settledMs;
+} MctsStats;
+
+/* The search settings and state below are per thread, so batch.c can run
+ * several searches at once. A new thread starts from the defaults. */
+extern __thread MctsConfig mctsConfig;
+extern __thread MctsStats mctsStats;
+
+/* Apply a comma separated list of name=value overrides, e.g.
+ * "playout_depth=2,puct_c=1.5". Returns 0, or -1 on an unknown name. */
+int mctsConfigParse(MctsConfig *config, const char *spec);
+/* One setting by name, integer ones rounded. Returns 0, or -1 on an unknown
+ * name. For tools that search over the settings. */
+int mctsConfigSet(MctsConfig *config, const char *name, double value);
+int mctsConfigGet(MctsConfig *config, const char *name, double *value);
+void mctsConfigPrint(FILE *fp, MctsConfig *config);
+
+/* Load the rollout policy and network like the agent does: the files given,
+ * else DEFAULT_POLICY_FILE and DEFAULT_NN_FILE if they're there. Returns 0,
+ * or -1 after saying so on stderr if a file given couldn't be loaded. */
+int mctsLoadModels(const char *policyFile, const char *netFile);
+// The -w and -m lines of a tool's usage that go with mctsLoadModels.
+void mctsModelUsage(void);
+
+/* Win rate of the move we picked last turn, run_mcts shortens the turn when
+ * it's very high or very low. */
+extern __thread double confidence;
+// TRUE when run_mcts is going to cap this turn at endTurnMs.
+int mctsShortTurn(void);
+// Iteration cap per search, defaults to MAXITER.
+extern __thread uint32_t maxIterations;
+/* Reproducible searches: run_mcts ignores maxMs and the clock and always
+ * does maxIterations, the solver gets SOLVER_FIXED_NODES on an empty table.
+ * A search is then a function of its position, settings and rngState. */
+extern __thread int fixedBudget;
+
 // Returns move [0..8]
 int run_mcts(State *rootState, Move lastMove, uint32_t maxMs);
+/* Free the node arena run_mcts keeps for the calling thread between
+ * searches. */
+void mctsArenaFree(void);
+
+/* A game between two settings at ms a move, X opening on (board, square).
+ * Returns the winner, 0 for a draw. */
+int mctsPlayGame(MctsConfig *cross, MctsConfig *circle, int board,
+                 int square, uint32_t ms);
+
+// servt's default clock, in ms.
+#define GAME_CLOCK_INITIAL_MS 30000
+#define GAME_CLOCK_PER_MOVE_MS 2000
 
-State *initState(int board, int prev_move, int first_move);
-void stateDoMove(State *state, Move move);
+/* The same with the agent's turn times under servt's clock, both scaled by
+ * timeScale. Running out loses. */
+int mctsPlayTimedGame(MctsConfig *cross, MctsConfig *circle, int board,
+                      int square, double timeScale);
 
-// Hacky adapter to provided print_board function.
-void printBoard(State *state);
 void whiteBoxTests(void);
 
 #endif
@@ -0,0 +1,303 @@
+/* Offline trainer for the value/policy network in nn.c.
+ *
+ * Plays self-play games with run_mcts at a fixed iteration budget and keeps
+ * every position with the root visit counts of its search and the final
+ * result. The network is then fitted by plain SGD: cross-entropy of the value
+ * head against the average of the game result (1 win, 0.5 draw, 0 loss for
+ * the player to move) and the search's own estimate, which is far less noisy
+ * than one game, plus cross-entropy of the policy head against the visit
+ * distribution. Positions can also come from selfplay shards given with -d.
+ *
+ * Example, a first net from playouts then a second from the first:
+ * ./nettrain -g 2000 -i 20000 -o net.bin
+ * ./nettrain -g 2000 -i 2000 -c network=1 -w net.bin -o net2.bin
+ * ./nettrain -d data/run1-000.bin -d data/run1-001.bin -o net.bin
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "nn.h"
+#include "record.h"
+#include "rng.h"
+
+#define DEFAULT_TRAIN_GAMES 200
+#define DEFAULT_TRAIN_ITERATIONS 20000
+#define DEFAULT_EPOCHS 20
+#define DEFAULT_LEARNING_RATE 0.01f
+// One in this many positions is kept back for the validation loss.
+#define VALIDATION_FRACTION 10
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+typedef struct sample {
+    State state;
+    float policy[BOARD_SIZE];
+    // Player to move, the result is filled in from this at the end.
+    uint8_t player;
+    // Search's win rate for the chosen move, then the training target.
+    float value;
+} Sample;
+
+static Sample *samples = NULL;
+static size_t numSamples = 0;
+static size_t maxSamples = 0;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-o network_file]\n");
+    printf("       [-w start_network_file]\n");  // also used by the self-play
+    printf("       [-d shard_file]\n");      // repeatable
+    printf("       [-g games]\n");               // 0 with -d
+    printf("       [-i iterations]\n");          // per move
+    printf("       [-e epochs]\n");
+    printf("       [-l learning_rate]\n");
+    printf("       [-c name=value,...]\n");      // self-play search settings
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+static Sample *newSample(void) {
+    if (numSamples == maxSamples) {
+        maxSamples = maxSamples ? maxSamples * 2 : 4096;
+        samples = realloc(samples, maxSamples * sizeof(Sample));
+        if (samples == NULL) {
+            perror("nettrain: realloc");
+            exit(1);
+        }
+    }
+    return &samples[numSamples++];
+}
+
+static void addSample(State *state, Move chosen) {
+    uint32_t total = 0;
+    Sample *sample = newSample();
+    sample->state = *state;
+    sample->player = (uint8_t)(3 - state->playerLastMoved);
+    sample->value = (float)confidence;
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        total += mctsStats.rootVisits[m];
+    }
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        // The solver answers without a tree, learn its move instead.
+        sample->policy[m] = total ? (float)mctsStats.rootVisits[m] / total
+                                  : (float)(m == chosen);
+    }
+}
+
+static void loadShard(const char *path) {
+    static Record records[4096];
+    size_t n;
+    FILE *fp = recordOpen(path);
+    if (fp == NULL) {
+        fprintf(stderr, "%s isn't a self-play shard\n", path);
+        exit(1);
+    }
+    while ((n = recordRead(fp, records, 4096)) > 0) {
+        for (size_t r = 0; r < n; r++) {
+            Record *record = &records[r];
+            uint32_t total = 0;
+            for (int m = 0; m < BOARD_SIZE; m++) {
+                total += record->visits[m];
+            }
+            if (total == 0) {
+                continue;
+            }
+            Sample *sample = newSample();
+            recordUnpack(record, &sample->state);
+            sample->player = record->toMove;
+            for (int m = 0; m < BOARD_SIZE; m++) {
+                sample->policy[m] = (float)record->visits[m] / total;
+            }
+            sample->value = 0.5f * ((float)record->value / UINT16_MAX +
+                                    0.5f * record->result);
+        }
+    }
+    fclose(fp);
+}
+
+static void selfPlay(int games, uint32_t iterations) {
+    maxIterations = iterations;
+    for (int g = 0; g < games; g++) {
+        State *state = initState(rand() % 9, rand() % 9, -1);
+        size_t first = numSamples;
+        moveNo = 1;
+        confidence = 0.5;
+        while (state->gameStatus == GAME_NOT_TERMINAL) {
+            moveNo++;
+            // Iterations are the budget, the time limit is just a backstop.
+            Move move = run_mcts(state, state->subBoard, 60000);
+            addSample(state, move);
+            stateDoMove(state, move);
+        }
+        int winner = 0;
+        if (state->gameStatus == GAME_WON) {
+            winner = state->playerLastMoved;
+        } else if (state->gameStatus == GAME_LOST) {
+            winner = 3 - state->playerLastMoved;
+        }
+        for (size_t s = first; s < numSamples; s++) {
+            float result = winner == 0                   ? 0.5f
+                           : winner == samples[s].player ? 1.0f
+                                                         : 0.0f;
+            samples[s].value = 0.5f * (samples[s].value + result);
+        }
+        free(state);
+        fprintf(stderr, "\rnettrain: game %d/%d, %lu positions", g + 1, games,
+                (unsigned long)numSamples);
+    }
+    fprintf(stderr, "\n");
+}
+
+// One SGD step on sample s, returns its loss. A rate of 0 just scores it.
+static float trainSample(Sample *s, float rate) {
+    uint16_t active[NN_MAX_ACTIVE];
+    float hidden[NN_HIDDEN];
+    float policy[BOARD_SIZE];
+    float dHidden[NN_HIDDEN];
+    float dLogits[BOARD_SIZE];
+    int n = nnInputs(&s->state, active);
+    float value = nnForward(&s->state, policy, hidden);
+
+    // Sigmoid and softmax with cross-entropy both give output - target.
+    float dValue = value - s->value;
+    float loss = -(s->value * logf(value + 1e-6f) +
+                   (1.0f - s->value) * logf(1.0f - value + 1e-6f));
+    for (int k = 0; k < BOARD_SIZE; k++) {
+        dLogits[k] = policy[k] - s->policy[k];
+        if (s->policy[k] > 0.0f) {
+            loss -= s->policy[k] * logf(policy[k] + 1e-6f);
+        }
+    }
+
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        float d = network.wv[j] * dValue;
+        for (int k = 0; k < BOARD_SIZE; k++) {
+            d += network.wp[j][k] * dLogits[k];
+        }
+        dHidden[j] = hidden[j] > 0.0f ? d : 0.0f;
+    }
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        network.wv[j] -= rate * dValue * hidden[j];
+        for (int k = 0; k < BOARD_SIZE; k++) {
+            network.wp[j][k] -= rate * dLogits[k] * hidden[j];
+        }
+    }
+    network.bv -= rate * dValue;
+    for (int k = 0; k < BOARD_SIZE; k++) {
+        network.bp[k] -= rate * dLogits[k];
+    }
+    for (int i = 0; i < n; i++) {
+        float *row = network.w1[active[i]];
+        for (int j = 0; j < NN_HIDDEN; j++) {
+            row[j] -= rate * dHidden[j];
+        }
+    }
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        network.b1[j] -= rate * dHidden[j];
+    }
+    return loss;
+}
+
+int main(int argc, char *argv[]) {
+    char *outFile = DEFAULT_NN_FILE;
+    int games = -1;
+    int numShards = 0;
+    uint32_t iterations = DEFAULT_TRAIN_ITERATIONS;
+    int epochs = DEFAULT_EPOCHS;
+    float rate = DEFAULT_LEARNING_RATE;
+    int haveStart = FALSE;
+    unsigned int seed = 1;
+    int i = 1;
+
+    mctsConfig.adaptiveTime = FALSE;
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            outFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (nnLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load network %s\n", argv[i + 1]);
+                return 1;
+            }
+            haveStart = TRUE;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            loadShard(argv[i + 1]);
+            numShards++;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            games = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            iterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-e") == 0) {
+            epochs = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-l") == 0) {
+            rate = (float)atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            if (mctsConfigParse(&mctsConfig, argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+
+    if (games < 0) {
+        games = numShards ? 0 : DEFAULT_TRAIN_GAMES;
+    }
+    srand(seed);
+    rngSeed(seed);
+    selfPlay(games, iterations);
+    if (!haveStart) {
+        nnRandomInit(seed);
+    }
+
+    // The last games are held out to watch for overfitting.
+    size_t numTrain = numSamples - numSamples / VALIDATION_FRACTION;
+    size_t *order = malloc(numSamples * sizeof(size_t));
+    for (size_t s = 0; s < numSamples; s++) {
+        order[s] = s;
+    }
+    for (int e = 0; e < epochs; e++) {
+        double loss = 0.0;
+        double validLoss = 0.0;
+        // Fisher-Yates shuffle each epoch.
+        for (size_t s = numTrain; s > 1; s--) {
+            size_t j = (size_t)rand() % s;
+            size_t t = order[s - 1];
+            order[s - 1] = order[j];
+            order[j] = t;
+        }
+        for (size_t s = 0; s < numTrain; s++) {
+            loss += trainSample(&samples[order[s]], rate);
+        }
+        for (size_t s = numTrain; s < numSamples; s++) {
+            validLoss += trainSample(&samples[s], 0.0f);
+        }
+        fprintf(stderr, "nettrain: epoch %d/%d loss %.4lf validation %.4lf\n",
+                e + 1, epochs, numTrain ? loss / numTrain : 0.0,
+                numSamples > numTrain ? validLoss / (numSamples - numTrain)
+                                      : 0.0);
+    }
+
+    if (nnSave(outFile) != 0) {
+        perror("nettrain: writing network");
+        return 1;
+    }
+    printf("Trained on %lu positions from %d games and %d shards into %s\n",
+           (unsigned long)numSamples, games, numShards, outFile);
+
+    free(order);
+    free(samples);
+    return 0;
+}
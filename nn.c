@@ -0,0 +1,176 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nn.h"
+
+Network network;
+
+int nnLoad(const char *path) {
+    NnHeader header;
+    static Network loaded;
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, NN_MAGIC, 4) == 0 &&
+             header.version == NN_VERSION && header.inputs == NN_INPUTS &&
+             header.hidden == NN_HIDDEN &&
+             fread(&loaded, sizeof(loaded), 1, fp) == 1;
+    fclose(fp);
+    if (!ok) {
+        return -1;
+    }
+    network = loaded;
+    return 0;
+}
+
+int nnSave(const char *path) {
+    NnHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NN_MAGIC, 4);
+    header.version = NN_VERSION;
+    header.inputs = NN_INPUTS;
+    header.hidden = NN_HIDDEN;
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(&network, sizeof(network), 1, fp) == 1;
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+void nnRandomInit(unsigned int seed) {
+    // He initialisation scaled for the ~40 inputs that are usually set.
+    float scale = sqrtf(2.0f / 40.0f);
+    srand(seed);
+    memset(&network, 0, sizeof(network));
+    for (int i = 0; i < NN_INPUTS; i++) {
+        for (int j = 0; j < NN_HIDDEN; j++) {
+            network.w1[i][j] = scale * ((float)rand() / RAND_MAX - 0.5f);
+        }
+    }
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        network.wv[j] = 0.1f * ((float)rand() / RAND_MAX - 0.5f);
+        for (int k = 0; k < BOARD_SIZE; k++) {
+            network.wp[j][k] = 0.1f * ((float)rand() / RAND_MAX - 0.5f);
+        }
+    }
+}
+
+int nnInputs(State *state, uint16_t active[NN_MAX_ACTIVE]) {
+    int player = 3 - state->playerLastMoved;
+    uint32_t ownShift = 9u * (player - 1);
+    uint32_t oppShift = 9u - ownShift;
+    int n = 0;
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        uint32_t own = (state->board[b] >> ownShift) & ALL_CIRCLES_MASK;
+        uint32_t opp = (state->board[b] >> oppShift) & ALL_CIRCLES_MASK;
+        for (; own; own &= own - 1) {
+            active[n++] = (uint16_t)(b * 9 + __builtin_ctz(own));
+        }
+        for (; opp; opp &= opp - 1) {
+            active[n++] = (uint16_t)(81 + b * 9 + __builtin_ctz(opp));
+        }
+    }
+    active[n++] = (uint16_t)(162 + state->subBoard);
+    uint32_t board = state->board[state->subBoard];
+    uint32_t own = (board >> ownShift) & ALL_CIRCLES_MASK;
+    uint32_t opp = (board >> oppShift) & ALL_CIRCLES_MASK;
+    for (; own; own &= own - 1) {
+        active[n++] = (uint16_t)(171 + __builtin_ctz(own));
+    }
+    for (; opp; opp &= opp - 1) {
+        active[n++] = (uint16_t)(180 + __builtin_ctz(opp));
+    }
+    return n;
+}
+
+static void nnHidden(State *state, float hidden[NN_HIDDEN]) {
+    uint16_t active[NN_MAX_ACTIVE];
+    int n = nnInputs(state, active);
+    memcpy(hidden, network.b1, sizeof(network.b1));
+    for (int i = 0; i < n; i++) {
+        const float *row = network.w1[active[i]];
+        for (int j = 0; j < NN_HIDDEN; j++) {
+            hidden[j] += row[j];
+        }
+    }
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        hidden[j] = hidden[j] > 0.0f ? hidden[j] : 0.0f;
+    }
+}
+
+// Softmax of the logits over the empty squares of the current sub-board.
+static void nnPolicy(State *state, float logits[BOARD_SIZE],
+                     float policy[BOARD_SIZE]) {
+    uint32_t board = state->board[state->subBoard];
+    uint32_t taken = (board | (board >> 9u)) & ALL_CIRCLES_MASK;
+    float maxLogit = -INFINITY;
+    float total = 0.0f;
+    for (int k = 0; k < BOARD_SIZE; k++) {
+        if (!(taken & (1u << k)) && logits[k] > maxLogit) {
+            maxLogit = logits[k];
+        }
+    }
+    for (int k = 0; k < BOARD_SIZE; k++) {
+        policy[k] = taken & (1u << k) ? 0.0f : expf(logits[k] - maxLogit);
+        total += policy[k];
+    }
+    for (int k = 0; k < BOARD_SIZE; k++) {
+        policy[k] = total > 0.0f ? policy[k] / total : 0.0f;
+    }
+}
+
+float nnForward(State *state, float policy[BOARD_SIZE],
+                float hidden[NN_HIDDEN]) {
+    float scratch[NN_HIDDEN];
+    float logits[BOARD_SIZE];
+    float value = network.bv;
+    hidden = hidden != NULL ? hidden : scratch;
+    nnHidden(state, hidden);
+    memcpy(logits, network.bp, sizeof(network.bp));
+    for (int j = 0; j < NN_HIDDEN; j++) {
+        value += network.wv[j] * hidden[j];
+        for (int k = 0; k < BOARD_SIZE; k++) {
+            logits[k] += network.wp[j][k] * hidden[j];
+        }
+    }
+    nnPolicy(state, logits, policy);
+    return 1.0f / (1.0f + expf(-value));
+}
+
+void nnEvaluate(State *states, int n, float *values,
+                float policies[][BOARD_SIZE]) {
+    float hidden[NN_BATCH][NN_HIDDEN];
+    float logits[NN_BATCH][BOARD_SIZE];
+
+    for (int start = 0; start < n; start += NN_BATCH) {
+        int count = n - start < NN_BATCH ? n - start : NN_BATCH;
+        for (int s = 0; s < count; s++) {
+            nnHidden(&states[start + s], hidden[s]);
+        }
+        // Walk the output weights once for the whole batch.
+        for (int s = 0; s < count; s++) {
+            values[start + s] = network.bv;
+            memcpy(logits[s], network.bp, sizeof(network.bp));
+        }
+        for (int j = 0; j < NN_HIDDEN; j++) {
+            for (int s = 0; s < count; s++) {
+                float h = hidden[s][j];
+                values[start + s] += network.wv[j] * h;
+                for (int k = 0; k < BOARD_SIZE; k++) {
+                    logits[s][k] += network.wp[j][k] * h;
+                }
+            }
+        }
+        for (int s = 0; s < count; s++) {
+            values[start + s] = 1.0f / (1.0f + expf(-values[start + s]));
+            nnPolicy(&states[start + s], logits[s], policies[start + s]);
+        }
+    }
+}
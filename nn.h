@@ -0,0 +1,67 @@
+#ifndef __NN_H__
+#define __NN_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Small value/policy network evaluated on the CPU.
+ *
+ * Inputs are the 162 squares of the board from the point of view of the
+ * player to move (81 own, then 81 opponent), a one-hot current sub-board and
+ * the 18 squares of the current sub-board again, which is where every move
+ * and both heads' answers are decided. At most 91 of the 189 inputs are ever
+ * set so the hidden layer is built by
+ * adding up the weight rows of the set inputs, the loops over NN_HIDDEN are
+ * plain float arithmetic that gcc vectorizes at -O3. One ReLU hidden layer
+ * feeds a sigmoid value head (win probability for the player to move) and a
+ * 9 way policy head over the squares of the current sub-board. */
+
+#define NN_INPUTS 189
+#define NN_HIDDEN 64
+// Most inputs a position can set, 81 marks, the sub-board and its 9 marks.
+#define NN_MAX_ACTIVE 91
+// Leaves run_mcts collects before evaluating them together.
+#define NN_BATCH 16
+#define NN_MAGIC "NBNN"
+#define NN_VERSION 1
+#define DEFAULT_NN_FILE "net.bin"
+
+typedef struct nnHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t hidden;
+} NnHeader;
+
+typedef struct network {
+    float w1[NN_INPUTS][NN_HIDDEN];
+    float b1[NN_HIDDEN];
+    float wv[NN_HIDDEN];
+    float bv;
+    float wp[NN_HIDDEN][BOARD_SIZE];
+    float bp[BOARD_SIZE];
+} Network;
+
+// All zero until something is loaded, which evaluates to 0.5 and uniform.
+extern Network network;
+
+// Returns 0 on success, -1 leaving the network alone on a bad file.
+int nnLoad(const char *path);
+int nnSave(const char *path);
+// Small random weights to start training from.
+void nnRandomInit(unsigned int seed);
+
+/* Fills active with the indices of the set inputs for state and returns how
+ * many there are. */
+int nnInputs(State *state, uint16_t active[NN_MAX_ACTIVE]);
+
+/* Forward pass for a single position. hidden (post ReLU) may be NULL,
+ * policy gets probabilities over the legal squares, 0 elsewhere. */
+float nnForward(State *state, float policy[BOARD_SIZE],
+                float hidden[NN_HIDDEN]);
+// Forward pass for n positions at once, sharing the output layer loads.
+void nnEvaluate(State *states, int n, float *values,
+                float policies[][BOARD_SIZE]);
+
+#endif
@@ -0,0 +1,196 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+#define TRUE 1
+#define FALSE 0
+
+int perfEnabled = FALSE;
+
+static const char *counterNames[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"};
+static const uint64_t counterConfigs[PERF_NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+static const char *phaseNames[PERF_NUM_PHASES] = {"select", "expand",
+                                                  "playout", "backprop"};
+
+static int groupFd = -1;
+static int counterFds[PERF_NUM_COUNTERS];
+// Position of each counter in the group read, -1 if the counter isn't there.
+static int counterSlot[PERF_NUM_COUNTERS];
+static int numOpen = 0;
+
+static PerfSample turnStart;
+static PerfSample phaseMark;
+static PerfSample phaseTotals[PERF_NUM_PHASES];
+static uint64_t phaseSamples = 0;
+static PerfSample gameTotals;
+static uint64_t gameIterations = 0;
+
+static long perfEventOpen(struct perf_event_attr *attr, int groupLeader) {
+    // Count this process on whatever CPU it happens to be on.
+    return syscall(SYS_perf_event_open, attr, 0, -1, groupLeader, 0);
+}
+
+static void perfRead(PerfSample *sample) {
+    // nr followed by one value per open counter.
+    uint64_t buf[1 + PERF_NUM_COUNTERS];
+    memset(sample, 0, sizeof(PerfSample));
+    if (read(groupFd, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t)) {
+        return;
+    }
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        if (counterSlot[c] >= 0 && (uint64_t)counterSlot[c] < buf[0]) {
+            sample->v[c] = buf[1 + counterSlot[c]];
+        }
+    }
+}
+
+static void sampleAccumulate(PerfSample *total, PerfSample *from,
+                             PerfSample *to) {
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        total->v[c] += to->v[c] - from->v[c];
+    }
+}
+
+static void printCounter(FILE *fp, int c, double value) {
+    if (counterSlot[c] < 0) {
+        fprintf(fp, " %s: n/a", counterNames[c]);
+    } else {
+        fprintf(fp, " %s: %.1lf", counterNames[c], value);
+    }
+}
+
+int perfInit(void) {
+    struct perf_event_attr attr;
+
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        counterFds[c] = -1;
+        counterSlot[c] = -1;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counterConfigs[c];
+        attr.read_format = PERF_FORMAT_GROUP;
+        // Excluding the kernel lets us run with perf_event_paranoid = 2.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.disabled = groupFd == -1;
+
+        int fd = (int)perfEventOpen(&attr, groupFd);
+        if (fd < 0) {
+            if (groupFd == -1) {
+                fprintf(stderr,
+                        "perf: hardware counters unavailable (%s), "
+                        "profiling disabled\n",
+                        strerror(errno));
+                return FALSE;
+            }
+            // Leader is up, just report this one as n/a.
+            fprintf(stderr, "perf: %s unavailable (%s)\n", counterNames[c],
+                    strerror(errno));
+            continue;
+        }
+        if (groupFd == -1) {
+            groupFd = fd;
+        }
+        counterFds[c] = fd;
+        counterSlot[c] = numOpen++;
+    }
+
+    ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perfEnabled = TRUE;
+    return TRUE;
+}
+
+void perfCleanup(void) {
+    if (!perfEnabled) {
+        return;
+    }
+    for (int c = PERF_NUM_COUNTERS - 1; c >= 0; c--) {
+        if (counterFds[c] >= 0) {
+            close(counterFds[c]);
+        }
+    }
+    groupFd = -1;
+    numOpen = 0;
+    perfEnabled = FALSE;
+}
+
+void perfTurnStart(void) {
+    if (perfEnabled) {
+        perfRead(&turnStart);
+    }
+}
+
+void perfTurnEnd(int turn, uint32_t iterations) {
+    PerfSample end, delta;
+    if (!perfEnabled) {
+        return;
+    }
+    perfRead(&end);
+    memset(&delta, 0, sizeof(delta));
+    sampleAccumulate(&delta, &turnStart, &end);
+    sampleAccumulate(&gameTotals, &turnStart, &end);
+    gameIterations += iterations;
+
+    double iters = iterations > 0 ? (double)iterations : 1.0;
+    fprintf(stderr, "perf T:%d iters: %u IPC: %.2lf per iter:", turn,
+            iterations,
+            delta.v[PERF_CYCLES] > 0 ? (double)delta.v[PERF_INSTRUCTIONS] /
+                                           (double)delta.v[PERF_CYCLES]
+                                     : 0.0);
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        printCounter(stderr, c, (double)delta.v[c] / iters);
+    }
+    fprintf(stderr, "\n");
+}
+
+void perfPhaseBegin(void) {
+    perfRead(&phaseMark);
+    phaseSamples++;
+}
+
+void perfPhaseEnd(int phase) {
+    PerfSample now;
+    perfRead(&now);
+    sampleAccumulate(&phaseTotals[phase], &phaseMark, &now);
+    // Don't charge our own read to the next phase.
+    perfRead(&phaseMark);
+}
+
+void perfReport(FILE *fp) {
+    if (!perfEnabled) {
+        return;
+    }
+    double iters = gameIterations > 0 ? (double)gameIterations : 1.0;
+    fprintf(fp, "perf game iters: %lu per iter:",
+            (unsigned long)gameIterations);
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        printCounter(fp, c, (double)gameTotals.v[c] / iters);
+    }
+    fprintf(fp, "\n");
+
+    double samples = phaseSamples > 0 ? (double)phaseSamples : 1.0;
+    for (int p = 0; p < PERF_NUM_PHASES; p++) {
+        fprintf(fp, "perf phase %-8s per iter:", phaseNames[p]);
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+            printCounter(fp, c, (double)phaseTotals[p].v[c] / samples);
+        }
+        fprintf(fp, "\n");
+    }
+
+    memset(&gameTotals, 0, sizeof(gameTotals));
+    memset(phaseTotals, 0, sizeof(phaseTotals));
+    gameIterations = 0;
+    phaseSamples = 0;
+}
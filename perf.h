@@ -0,0 +1,59 @@
+#ifndef __PERF_H__
+#define __PERF_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Optional hardware performance counter profiling built on Linux
+ * perf_event_open. All counters are opened as a single group so one read()
+ * gives a consistent snapshot of every counter. If the kernel refuses to give
+ * us counters (containers, perf_event_paranoid, VMs without a PMU) profiling
+ * disables itself and every hook below becomes a no-op. */
+
+// Only every 64th iteration has its phases measured, reading the counters
+// costs a syscall so doing it on every phase of every iteration would drown
+// out the thing we're trying to measure.
+#define PERF_PHASE_SAMPLE_MASK 63u
+
+enum perfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_COUNTERS
+};
+
+enum perfPhase {
+    PERF_PHASE_SELECT,
+    PERF_PHASE_EXPAND,
+    PERF_PHASE_PLAYOUT,
+    PERF_PHASE_BACKPROP,
+    PERF_NUM_PHASES
+};
+
+typedef struct perfSample {
+    uint64_t v[PERF_NUM_COUNTERS];
+} PerfSample;
+
+// TRUE once perfInit has managed to open at least the cycle counter.
+extern int perfEnabled;
+
+/* Open the counters. Returns TRUE on success, otherwise prints why to stderr
+ * and leaves profiling disabled. */
+int perfInit(void);
+void perfCleanup(void);
+
+// Per turn accounting, wraps a whole run_mcts call.
+void perfTurnStart(void);
+void perfTurnEnd(int turn, uint32_t iterations);
+
+/* Per phase accounting for sampled iterations. perfPhaseBegin marks the start
+ * of an iteration and each perfPhaseEnd charges everything since the last mark
+ * to the given phase. */
+void perfPhaseBegin(void);
+void perfPhaseEnd(int phase);
+
+// Print the totals accumulated over the game and reset them.
+void perfReport(FILE *fp);
+
+#endif
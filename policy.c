@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "policy.h"
+#include "rng.h"
+
+uint8_t policyLocal[POLICY_PATTERNS][BOARD_SIZE];
+uint8_t policyDest[POLICY_PATTERNS];
+
+// base3[p] is the 9 bit pattern p read as a base 3 number with digits 0/1.
+static uint16_t base3[512];
+static int policyReady = 0;
+
+void policyInit(void) {
+    if (policyReady) {
+        return;
+    }
+    for (uint32_t p = 0; p < 512; p++) {
+        uint32_t v = 0;
+        for (int s = BOARD_SIZE - 1; s >= 0; s--) {
+            v = v * 3 + ((p >> s) & 1u);
+        }
+        base3[p] = (uint16_t)v;
+    }
+    policyReady = 1;
+    policyReset();
+}
+
+void policyReset(void) {
+    memset(policyLocal, POLICY_DEFAULT_WEIGHT, sizeof(policyLocal));
+    memset(policyDest, POLICY_DEFAULT_WEIGHT, sizeof(policyDest));
+}
+
+int policyLoad(const char *path) {
+    PolicyHeader header;
+    static uint8_t local[POLICY_PATTERNS][BOARD_SIZE];
+    static uint8_t dest[POLICY_PATTERNS];
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+    int ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+             memcmp(header.magic, POLICY_MAGIC, 4) == 0 &&
+             header.version == POLICY_VERSION &&
+             header.patterns == POLICY_PATTERNS &&
+             fread(local, sizeof(local), 1, fp) == 1 &&
+             fread(dest, sizeof(dest), 1, fp) == 1;
+    fclose(fp);
+    // policySample divides by the total weight, so none may be 0.
+    for (size_t i = 0; ok && i < sizeof(local); i++) {
+        ok = ((uint8_t *)local)[i] != 0;
+    }
+    for (size_t i = 0; ok && i < sizeof(dest); i++) {
+        ok = dest[i] != 0;
+    }
+    if (!ok) {
+        return -1;
+    }
+    policyInit();
+    memcpy(policyLocal, local, sizeof(local));
+    memcpy(policyDest, dest, sizeof(dest));
+    return 0;
+}
+
+int policySave(const char *path) {
+    PolicyHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, POLICY_MAGIC, 4);
+    header.version = POLICY_VERSION;
+    header.patterns = POLICY_PATTERNS;
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(policyLocal, sizeof(policyLocal), 1, fp) == 1 &&
+             fwrite(policyDest, sizeof(policyDest), 1, fp) == 1;
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+uint32_t policyPattern(uint32_t board, int player) {
+    uint32_t circles = board & ALL_CIRCLES_MASK;
+    uint32_t crosses = (board >> 9u) & ALL_CIRCLES_MASK;
+    return player == CIRCLE_PLAYER ? base3[circles] + 2u * base3[crosses]
+                                   : base3[crosses] + 2u * base3[circles];
+}
+
+Move policySample(State *state, Move *moves, uint32_t nMoves) {
+    int player = 3 - state->playerLastMoved;
+    int opponent = state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+    uint32_t ourMark = player == CIRCLE_PLAYER ? CIRCLE_PLAYER_START
+                                               : CROSS_PLAYER_START;
+    const uint8_t *local = policyLocal[policyPattern(board, player)];
+    uint32_t weights[BOARD_SIZE];
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < nMoves; i++) {
+        Move m = moves[i];
+        uint32_t dest = m == state->subBoard ? board | (ourMark << m)
+                                             : state->board[m];
+        weights[i] = (uint32_t)local[m] *
+                     policyDest[policyPattern(dest, opponent)];
+        total += weights[i];
+    }
+
+    uint32_t r = rngNext() % total;
+    uint32_t i = 0;
+    while (r >= weights[i]) {
+        r -= weights[i++];
+    }
+    return moves[i];
+}
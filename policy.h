@@ -0,0 +1,47 @@
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Table driven rollout policy. A playout move's weight is
+ *   local[pattern of the current sub-board][square] *
+ *   dest[pattern of the sub-board it sends the opponent to]
+ * where patterns are the 3^9 ternary encodings of a sub-board seen from the
+ * player about to move on it. Moves are sampled in proportion to weight.
+ * policytrain.c fits the tables from self-play. */
+
+#define POLICY_PATTERNS 19683
+// Weight of every entry before anything is loaded, so playouts are uniform.
+#define POLICY_DEFAULT_WEIGHT 16
+#define POLICY_MAGIC "NBTR"
+#define POLICY_VERSION 1
+#define DEFAULT_POLICY_FILE "policy.bin"
+
+typedef struct policyHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t patterns;
+    uint32_t reserved;
+} PolicyHeader;
+
+extern uint8_t policyLocal[POLICY_PATTERNS][BOARD_SIZE];
+extern uint8_t policyDest[POLICY_PATTERNS];
+
+/* Builds the pattern tables and sets the default weights the first time it's
+ * called, later calls do nothing. */
+void policyInit(void);
+// Sets every weight to POLICY_DEFAULT_WEIGHT.
+void policyReset(void);
+/* Returns 0 on success, -1 leaving the tables alone if path isn't a policy
+ * or has a zero weight. */
+int policyLoad(const char *path);
+int policySave(const char *path);
+
+// Ternary pattern of a sub-board from player's point of view.
+uint32_t policyPattern(uint32_t board, int player);
+// Sample one of moves for the player to move according to the tables.
+Move policySample(State *state, Move *moves, uint32_t nMoves);
+
+#endif
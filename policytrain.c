@@ -0,0 +1,261 @@
+/* Offline trainer for the rollout policy in policy.c.
+ *
+ * Plays self-play games with run_mcts at a fixed iteration budget, keeps every
+ * position along with the move the search chose, then fits the pattern
+ * weights with Coulom's minorization-maximization algorithm for generalized
+ * Bradley-Terry models: each candidate move is a team of its local feature
+ * (sub-board pattern, square) and its destination feature (pattern of the
+ * sub-board the opponent is sent to). Every feature also gets one virtual win
+ * and one virtual loss against a feature of strength 1 so rare patterns stay
+ * near uniform. Positions can also come from selfplay shards given with -d,
+ * the most visited move standing in for the chosen one.
+ *
+ * Example:
+ * ./policytrain -g 2000 -i 20000 -o policy.bin
+ * ./policytrain -d data/run1-000.bin -d data/run1-001.bin -o policy.bin
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "policy.h"
+#include "record.h"
+#include "rng.h"
+
+#define DEFAULT_TRAIN_GAMES 200
+#define DEFAULT_TRAIN_ITERATIONS 20000
+#define DEFAULT_MM_ROUNDS 20
+#define LOCAL_FEATURES (POLICY_PATTERNS * BOARD_SIZE)
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+typedef struct sample {
+    uint32_t local[BOARD_SIZE];
+    uint16_t dest[BOARD_SIZE];
+    uint8_t nMoves;
+    uint8_t chosen;
+} Sample;
+
+static Sample *samples = NULL;
+static size_t numSamples = 0;
+static size_t maxSamples = 0;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-o policy_file]\n");
+    printf("       [-w start_policy_file]\n");  // used by the self-play
+    printf("       [-d shard_file]\n");   // repeatable
+    printf("       [-g games]\n");            // 0 with -d
+    printf("       [-i iterations]\n");         // per move
+    printf("       [-n mm_rounds]\n");
+    printf("       [-c name=value,...]\n");     // self-play search settings
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+static void addSample(State *state, Move chosen) {
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    int player = 3 - state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+    uint32_t ourMark = player == CIRCLE_PLAYER ? CIRCLE_PLAYER_START
+                                               : CROSS_PLAYER_START;
+
+    if (numSamples == maxSamples) {
+        maxSamples = maxSamples ? maxSamples * 2 : 4096;
+        samples = realloc(samples, maxSamples * sizeof(Sample));
+        if (samples == NULL) {
+            perror("policytrain: realloc");
+            exit(1);
+        }
+    }
+    Sample *sample = &samples[numSamples];
+    stateGetMoves(state, moves, &nMoves);
+    uint32_t pattern = policyPattern(board, player);
+    sample->nMoves = (uint8_t)nMoves;
+    sample->chosen = BOARD_SIZE;
+    for (uint32_t i = 0; i < nMoves; i++) {
+        Move m = moves[i];
+        uint32_t dest = m == state->subBoard ? board | (ourMark << m)
+                                             : state->board[m];
+        sample->local[i] = pattern * BOARD_SIZE + m;
+        sample->dest[i] = (uint16_t)policyPattern(dest, 3 - player);
+        if (m == chosen) {
+            sample->chosen = (uint8_t)i;
+        }
+    }
+    /* A shard record with no visits picks square 0, which needn't be legal.
+     * Keep only samples whose move was one of the choices. */
+    if (sample->chosen < nMoves) {
+        numSamples++;
+    }
+}
+
+static void loadShard(const char *path) {
+    static Record records[4096];
+    size_t n;
+    FILE *fp = recordOpen(path);
+    if (fp == NULL) {
+        fprintf(stderr, "%s isn't a self-play shard\n", path);
+        exit(1);
+    }
+    while ((n = recordRead(fp, records, 4096)) > 0) {
+        for (size_t r = 0; r < n; r++) {
+            State state;
+            Move chosen = 0;
+            for (int m = 1; m < BOARD_SIZE; m++) {
+                if (records[r].visits[m] > records[r].visits[chosen]) {
+                    chosen = (Move)m;
+                }
+            }
+            recordUnpack(&records[r], &state);
+            addSample(&state, chosen);
+        }
+    }
+    fclose(fp);
+}
+
+static void selfPlay(int games, uint32_t iterations) {
+    maxIterations = iterations;
+    for (int g = 0; g < games; g++) {
+        State *state = initState(rand() % 9, rand() % 9, -1);
+        moveNo = 1;
+        confidence = 0.5;
+        while (state->gameStatus == GAME_NOT_TERMINAL) {
+            moveNo++;
+            // Iterations are the budget, the time limit is just a backstop.
+            Move move = run_mcts(state, state->subBoard, 60000);
+            addSample(state, move);
+            stateDoMove(state, move);
+        }
+        free(state);
+        fprintf(stderr, "\rpolicytrain: game %d/%d, %lu positions", g + 1,
+                games, (unsigned long)numSamples);
+    }
+    fprintf(stderr, "\n");
+}
+
+/* One MM update of either the local or the destination strengths, holding the
+ * other fixed. */
+static void mmRound(double *local, double *dest, int updateLocal) {
+    size_t n = updateLocal ? LOCAL_FEATURES : POLICY_PATTERNS;
+    double *gamma = updateLocal ? local : dest;
+    double *wins = calloc(n, sizeof(double));
+    double *denom = calloc(n, sizeof(double));
+
+    for (size_t j = 0; j < numSamples; j++) {
+        Sample *s = &samples[j];
+        double strength[BOARD_SIZE];
+        double total = 0.0;
+        for (int k = 0; k < s->nMoves; k++) {
+            strength[k] = local[s->local[k]] * dest[s->dest[k]];
+            total += strength[k];
+        }
+        for (int k = 0; k < s->nMoves; k++) {
+            size_t f = updateLocal ? s->local[k] : s->dest[k];
+            // Strength of the candidate without feature f.
+            denom[f] += strength[k] / gamma[f] / total;
+        }
+        wins[updateLocal ? s->local[s->chosen] : s->dest[s->chosen]] += 1.0;
+    }
+    for (size_t f = 0; f < n; f++) {
+        gamma[f] = (wins[f] + 1.0) / (denom[f] + 2.0 / (gamma[f] + 1.0));
+    }
+    free(wins);
+    free(denom);
+}
+
+static uint8_t quantize(double gamma) {
+    double w = round(POLICY_DEFAULT_WEIGHT * gamma);
+    return (uint8_t)(w < 1.0 ? 1.0 : w > 255.0 ? 255.0 : w);
+}
+
+int main(int argc, char *argv[]) {
+    char *outFile = DEFAULT_POLICY_FILE;
+    int games = -1;
+    int numShards = 0;
+    uint32_t iterations = DEFAULT_TRAIN_ITERATIONS;
+    int rounds = DEFAULT_MM_ROUNDS;
+    unsigned int seed = 1;
+    int i = 1;
+
+    policyInit();
+    mctsConfig.adaptiveTime = FALSE;
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            outFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (policyLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load policy %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-d") == 0) {
+            loadShard(argv[i + 1]);
+            numShards++;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            games = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            iterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            rounds = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            if (mctsConfigParse(&mctsConfig, argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+
+    if (games < 0) {
+        games = numShards ? 0 : DEFAULT_TRAIN_GAMES;
+    }
+    srand(seed);
+    rngSeed(seed);
+    selfPlay(games, iterations);
+
+    double *local = malloc(LOCAL_FEATURES * sizeof(double));
+    double *dest = malloc(POLICY_PATTERNS * sizeof(double));
+    for (size_t f = 0; f < LOCAL_FEATURES; f++) {
+        local[f] = 1.0;
+    }
+    for (size_t f = 0; f < POLICY_PATTERNS; f++) {
+        dest[f] = 1.0;
+    }
+    for (int r = 0; r < rounds; r++) {
+        mmRound(local, dest, TRUE);
+        mmRound(local, dest, FALSE);
+        fprintf(stderr, "\rpolicytrain: MM round %d/%d", r + 1, rounds);
+    }
+    fprintf(stderr, "\n");
+
+    for (size_t f = 0; f < LOCAL_FEATURES; f++) {
+        policyLocal[f / BOARD_SIZE][f % BOARD_SIZE] = quantize(local[f]);
+    }
+    for (size_t f = 0; f < POLICY_PATTERNS; f++) {
+        policyDest[f] = quantize(dest[f]);
+    }
+    if (policySave(outFile) != 0) {
+        perror("policytrain: writing policy");
+        return 1;
+    }
+    printf("Fitted %lu positions from %d games and %d shards into %s\n",
+           (unsigned long)numSamples, games, numShards, outFile);
+
+    free(local);
+    free(dest);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "common.h"
+#include "proto.h"
+
+typedef struct keyword {
+    const char *name;
+    size_t len;
+    int value;
+} Keyword;
+
+#define KEYWORD(name, value) {name, sizeof(name) - 1, value}
+
+// Message names, and below how many arguments each takes in brackets.
+static const Keyword messages[] = {
+    KEYWORD("init", MSG_INIT),
+    KEYWORD("think_time", MSG_THINK_TIME),
+    KEYWORD("start", MSG_START),
+    KEYWORD("second_move", MSG_SECOND_MOVE),
+    KEYWORD("third_move", MSG_THIRD_MOVE),
+    KEYWORD("next_move", MSG_NEXT_MOVE),
+    KEYWORD("last_move", MSG_LAST_MOVE),
+    KEYWORD("win", MSG_WIN),
+    KEYWORD("loss", MSG_LOSS),
+    KEYWORD("draw", MSG_DRAW),
+    KEYWORD("end", MSG_END),
+};
+static const int messageArgs[] = {
+    [MSG_INIT] = 0,        [MSG_THINK_TIME] = 0, [MSG_START] = 1,
+    [MSG_SECOND_MOVE] = 2, [MSG_THIRD_MOVE] = 3, [MSG_NEXT_MOVE] = 1,
+    [MSG_LAST_MOVE] = 1,   [MSG_WIN] = 1,        [MSG_LOSS] = 1,
+    [MSG_DRAW] = 1,        [MSG_END] = 0,
+};
+
+static const Keyword causes[] = {
+    KEYWORD("triple", TRIPLE),
+    KEYWORD("timeout", TIMEOUT),
+    KEYWORD("illegal_move", ILLEGAL_MOVE),
+    KEYWORD("full_board", FULL_BOARD),
+};
+
+static const Keyword *findKeyword(const Keyword *table, size_t n,
+                                  const char *s, size_t len) {
+    for (size_t i = 0; i < n; i++) {
+        if (table[i].len == len && memcmp(table[i].name, s, len) == 0) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+// Length of the identifier at s, letters and underscores.
+static size_t wordLength(const char *s, const char *end) {
+    const char *p = s;
+    while (p < end && ((*p >= 'a' && *p <= 'z') || *p == '_')) {
+        p++;
+    }
+    return (size_t)(p - s);
+}
+
+// Reads a decimal number at *s, moving *s past it. FALSE if there isn't one.
+static int parseNumber(const char **s, const char *end, long *value) {
+    const char *p = *s;
+    int negative = p < end && *p == '-';
+    long v = 0;
+    p += negative;
+    if (p == end || *p < '0' || *p > '9') {
+        return FALSE;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    *value = negative ? -v : v;
+    *s = p;
+    return TRUE;
+}
+
+static const char *skipSpace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+int protoParse(const char *line, size_t len, ProtoMessage *msg) {
+    const char *p = skipSpace(line, line + len);
+    const char *end = line + len;
+    long value;
+    msg->type = MSG_UNKNOWN;
+    msg->thinkUs = -1;
+
+    // An agent's reply, the move and maybe its think time.
+    if (parseNumber(&p, end, &value)) {
+        msg->args[0] = (int)value;
+        p = skipSpace(p, end);
+        if (parseNumber(&p, end, &value)) {
+            msg->thinkUs = value;
+        }
+        return msg->type = skipSpace(p, end) == end ? MSG_MOVE : MSG_UNKNOWN;
+    }
+
+    size_t n = wordLength(p, end);
+    const Keyword *k =
+        findKeyword(messages, sizeof(messages) / sizeof(*messages), p, n);
+    if (k == NULL) {
+        return MSG_UNKNOWN;
+    }
+    p += n;
+    int nArgs = messageArgs[k->value];
+    if (nArgs > 0) {
+        if (p == end || *p++ != '(') {
+            return MSG_UNKNOWN;
+        }
+        for (int a = 0; a < nArgs; a++) {
+            if (a > 0 && (p == end || *p++ != ',')) {
+                return MSG_UNKNOWN;
+            }
+            if (k->value == MSG_START) {
+                if (p == end || (*p != 'x' && *p != 'o')) {
+                    return MSG_UNKNOWN;
+                }
+                msg->args[a] = *p++ == 'x' ? 0 : 1;
+            } else if (k->value == MSG_WIN || k->value == MSG_LOSS ||
+                       k->value == MSG_DRAW) {
+                size_t c = wordLength(p, end);
+                const Keyword *cause = findKeyword(
+                    causes, sizeof(causes) / sizeof(*causes), p, c);
+                // Same fallback as the original client.
+                msg->args[a] = cause ? cause->value : TRIPLE;
+                p += c;
+            } else if (parseNumber(&p, end, &value)) {
+                msg->args[a] = (int)value;
+            } else {
+                return MSG_UNKNOWN;
+            }
+        }
+        if (p == end || *p++ != ')') {
+            return MSG_UNKNOWN;
+        }
+    }
+    // The full stop is optional, the original client took a bare "end".
+    if (p < end && *p == '.') {
+        p++;
+    }
+    if (skipSpace(p, end) != end) {
+        return MSG_UNKNOWN;
+    }
+    return msg->type = k->value;
+}
+
+void protoInit(ProtoReader *reader, int fd) {
+    reader->fd = fd;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+static long msNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+int protoRead(ProtoReader *reader, ProtoMessage *msg, int timeoutMs) {
+    long deadline = timeoutMs >= 0 ? msNow() + timeoutMs : 0;
+    for (;;) {
+        char *line = reader->buf + reader->start;
+        char *nl = memchr(line, '\n', reader->end - reader->start);
+        if (nl != NULL) {
+            reader->start = (size_t)(nl + 1 - reader->buf);
+            if (skipSpace(line, nl) == nl) {
+                continue;
+            }
+            return protoParse(line, (size_t)(nl - line), msg);
+        }
+
+        // Make room for the rest of the line.
+        if (reader->start > 0) {
+            memmove(reader->buf, line, reader->end - reader->start);
+            reader->end -= reader->start;
+            reader->start = 0;
+        }
+        if (reader->end == PROTO_BUF_SIZE) {
+            // Nobody sends lines this long, drop it.
+            reader->end = 0;
+            return msg->type = MSG_UNKNOWN;
+        }
+        if (timeoutMs >= 0) {
+            struct pollfd pfd = {reader->fd, POLLIN, 0};
+            long left = deadline - msNow();
+            int ready = left > 0 ? poll(&pfd, 1, (int)left) : 0;
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready == 0) {
+                return msg->type = MSG_TIMEOUT;
+            }
+        }
+        ssize_t r = read(reader->fd, reader->buf + reader->end,
+                         PROTO_BUF_SIZE - reader->end);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return msg->type = MSG_EOF;
+        }
+        reader->end += (size_t)r;
+    }
+}
+
+int protoFullIo(int fd, void *buf, size_t n, int writing, int timeoutMs) {
+    char *p = buf;
+    while (n > 0) {
+        ssize_t r = writing ? send(fd, p, n, MSG_NOSIGNAL) : read(fd, p, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = {fd, writing ? POLLOUT : POLLIN, 0};
+            int ready = poll(&pfd, 1, timeoutMs);
+            if (ready > 0 || (ready < 0 && errno == EINTR)) {
+                continue;
+            }
+            return -1;
+        }
+        if (r <= 0) {
+            return -1;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __PROTO_H__
+#define __PROTO_H__
+
+#include <stddef.h>
+
+/* Server/agent protocol, one message a line: init., start(x)., next_move(4).
+ * and so on from the server, the move ("5", or "5 1234" with the think time
+ * in usec after think_time.) back from the agent. Lines are read through a
+ * fixed buffer straight off the file descriptor and parsed in place, nothing
+ * is allocated or copied per message, so servt and client.c share it over
+ * tcp, pipes or a socketpair alike. */
+
+#define PROTO_BUF_SIZE 4096
+
+// Message types, protoRead also returns MSG_EOF and MSG_TIMEOUT.
+#define MSG_EOF -2
+#define MSG_TIMEOUT -1
+#define MSG_UNKNOWN 0
+#define MSG_INIT 1
+#define MSG_THINK_TIME 2
+#define MSG_START 3
+#define MSG_SECOND_MOVE 4
+#define MSG_THIRD_MOVE 5
+#define MSG_NEXT_MOVE 6
+#define MSG_LAST_MOVE 7
+#define MSG_WIN 8
+#define MSG_LOSS 9
+#define MSG_DRAW 10
+#define MSG_END 11
+#define MSG_MOVE 12
+
+typedef struct protoMessage {
+    int type;
+    /* In message order: start has 0 for x and 1 for o, second_move board and
+     * move, third_move board, first and previous move, next_move and
+     * last_move the previous move, win/loss/draw the cause (TRIPLE, TIMEOUT,
+     * ILLEGAL_MOVE or FULL_BOARD from common.h) and a move the square. */
+    int args[3];
+    // Think time in usec sent with a move, -1 without one.
+    long thinkUs;
+} ProtoMessage;
+
+typedef struct protoReader {
+    int fd;
+    // Unparsed bytes are buf[start, end).
+    size_t start;
+    size_t end;
+    char buf[PROTO_BUF_SIZE];
+} ProtoReader;
+
+void protoInit(ProtoReader *reader, int fd);
+/* Next message from the reader, waiting at most timeoutMs, -1 for as long as
+ * it takes. Returns and fills in msg->type, blank lines are skipped. */
+int protoRead(ProtoReader *reader, ProtoMessage *msg, int timeoutMs);
+// Parses one line without its newline into msg, returns msg->type.
+int protoParse(const char *line, size_t len, ProtoMessage *msg);
+
+/* Read or write exactly n bytes of a binary message over a socket, for the
+ * search workers of dist.c and tune.c. A non-blocking fd gets up to
+ * timeoutMs (-1 for as long as it takes) to become ready each time it isn't.
+ * Returns 0, or -1 on EOF, error or timeout. */
+int protoFullIo(int fd, void *buf, size_t n, int writing, int timeoutMs);
+
+#endif
@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "record.h"
+
+void recordPack(Record *record, State *state, uint32_t visits[BOARD_SIZE],
+                double value, int ply) {
+    uint32_t total = 0;
+    memset(record, 0, sizeof(Record));
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        record->board[b / 3] |= (uint64_t)state->board[b] << (18 * (b % 3));
+    }
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        total += visits[m];
+    }
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        record->visits[m] =
+            total > UINT16_MAX
+                ? (uint16_t)((uint64_t)visits[m] * UINT16_MAX / total)
+                : (uint16_t)visits[m];
+    }
+    value = value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+    record->value = (uint16_t)(value * UINT16_MAX + 0.5);
+    record->subBoard = (uint8_t)state->subBoard;
+    record->toMove = (uint8_t)(3 - state->playerLastMoved);
+    record->ply = (uint8_t)ply;
+}
+
+void recordUnpack(Record *record, State *state) {
+    memset(state, 0, sizeof(State));
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        state->board[b] =
+            (uint32_t)(record->board[b / 3] >> (18 * (b % 3))) & 0x3ffff;
+    }
+    state->subBoard = record->subBoard;
+    state->playerLastMoved = 3 - record->toMove;
+    state->gameStatus = GAME_NOT_TERMINAL;
+    state->me = record->toMove;
+    state->opponent = 3 - record->toMove;
+}
+
+FILE *recordCreate(const char *path) {
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORD_MAGIC, 4);
+    header.version = RECORD_VERSION;
+    header.recordSize = sizeof(Record);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp != NULL && fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        fp = NULL;
+    }
+    return fp;
+}
+
+FILE *recordOpen(const char *path) {
+    RecordHeader header;
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, RECORD_MAGIC, 4) != 0 ||
+        header.version != RECORD_VERSION ||
+        header.recordSize != sizeof(Record)) {
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+size_t recordRead(FILE *fp, Record *records, size_t n) {
+    return fread(records, sizeof(Record), n, fp);
+}
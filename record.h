@@ -0,0 +1,59 @@
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mcts.h"
+
+/* Self-play training records (see selfplay.c).
+ *
+ * A shard file is a RecordHeader followed by fixed size Records, one per
+ * position searched, written a game at a time so a shard that's still being
+ * written can be read up to its last complete game. The board is packed
+ * three sub-boards of 18 bits to a word. Visit counts are the search's root
+ * visits per move, scaled down to fit 16 bits when the search was bigger
+ * than that. Everything is little endian, the only thing we run on. */
+
+#define RECORD_MAGIC "NBSP"
+#define RECORD_VERSION 1
+#define DEFAULT_RECORD_PREFIX "selfplay"
+
+typedef struct recordHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+} RecordHeader;
+
+typedef struct record {
+    uint64_t board[3];
+    uint16_t visits[BOARD_SIZE];
+    // Search's win rate for its move, scaled to 0..65535.
+    uint16_t value;
+    uint8_t subBoard;
+    // CIRCLE_PLAYER or CROSS_PLAYER.
+    uint8_t toMove;
+    // RECORD_WIN/DRAW/LOSS for toMove.
+    uint8_t result;
+    // Moves played before this position, counting the two opening ones.
+    uint8_t ply;
+} Record;
+
+#define RECORD_LOSS 0
+#define RECORD_DRAW 1
+#define RECORD_WIN 2
+
+// Fills in everything but result, which isn't known until the game ends.
+void recordPack(Record *record, State *state, uint32_t visits[BOARD_SIZE],
+                double value, int ply);
+void recordUnpack(Record *record, State *state);
+
+// Opens path for writing and writes the header, NULL on failure.
+FILE *recordCreate(const char *path);
+// Opens path for reading and checks the header, NULL if it isn't a shard.
+FILE *recordOpen(const char *path);
+// Reads up to n records, returns how many it got.
+size_t recordRead(FILE *fp, Record *records, size_t n);
+
+#endif
@@ -0,0 +1,100 @@
+/* Reader for the self-play shards written by selfplay.c.
+ *
+ * Prints a summary of the given shards, or with -d every position along
+ * with its visit counts, search value and result.
+ *
+ * Example:
+ * ./recread data/run1-*.bin
+ * ./recread -d -n 5 data/run1-000.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "record.h"
+
+#define READ_CHUNK 4096
+
+// Linked in search code refers to these.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       -d");            // dump every record
+    printf("       [-n records]\n");  // stop after this many
+    printf("       shard_file...\n");
+    exit(1);
+}
+
+static void dumpRecord(Record *record) {
+    static const char *results[] = {"loss", "draw", "win"};
+    State state;
+    recordUnpack(record, &state);
+    printBoard(&state);
+    printf("ply %d, %c to move on board %d, value %.3f, result %s\n",
+           record->ply, record->toMove == CIRCLE_PLAYER ? 'O' : 'X',
+           record->subBoard + 1, record->value / (double)UINT16_MAX,
+           record->result <= RECORD_WIN ? results[record->result] : "?");
+    printf("visits:");
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        printf(" %u", record->visits[m]);
+    }
+    printf("\n\n");
+}
+
+int main(int argc, char *argv[]) {
+    static Record records[READ_CHUNK];
+    int dump = FALSE;
+    uint64_t limit = UINT64_MAX;
+    uint64_t total = 0;
+    uint64_t results[RECORD_WIN + 1] = {0};
+    uint64_t plies = 0;
+    int i = 1;
+
+    while (i < argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "-d") == 0) {
+            dump = TRUE;
+            i++;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            limit = strtoull(argv[i + 1], NULL, 10);
+            i += 2;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i == argc) {
+        usage(argv[0]);
+    }
+
+    for (; i < argc && total < limit; i++) {
+        FILE *fp = recordOpen(argv[i]);
+        size_t n;
+        if (fp == NULL) {
+            fprintf(stderr, "%s isn't a self-play shard\n", argv[i]);
+            return 1;
+        }
+        while (total < limit && (n = recordRead(fp, records, READ_CHUNK)) > 0) {
+            for (size_t r = 0; r < n && total < limit; r++, total++) {
+                if (dump) {
+                    dumpRecord(&records[r]);
+                }
+                if (records[r].result <= RECORD_WIN) {
+                    results[records[r].result]++;
+                }
+                plies += records[r].ply;
+            }
+        }
+        fclose(fp);
+    }
+
+    printf("%lu positions, side to move W/D/L: %lu/%lu/%lu, mean ply %.1lf\n",
+           (unsigned long)total, (unsigned long)results[RECORD_WIN],
+           (unsigned long)results[RECORD_DRAW],
+           (unsigned long)results[RECORD_LOSS],
+           total ? (double)plies / total : 0.0);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/* Re-runs the searches in an agent game log (agent -l) bit for bit.
+ *
+ * Every search line has the position, the rngState the search started from
+ * and how many iterations it did, so each one is redone with exactly that
+ * budget and must come back with the same move and iteration count. Games
+ * played with -i replay exactly. Clock bound games do as well, apart from
+ * the late searches where the solver was tried, it gets a node budget here
+ * instead of the clock. Give the same -w and -m files as the agent had, and
+ * don't expect a match if it had a position store (-s) or search workers.
+ *
+ * Handy for bisecting a slowdown or profiling on identical work, -x repeats
+ * each search and the totals give iterations per second.
+ *
+ * Example:
+ * ./agent -p 12345 -r 7 -i 200000 -l game.log
+ * ./replay game.log
+ * ./replay -g 1 -t 15 -x 10 game.log
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "rng.h"
+
+// Linked in search code refers to these.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       -v");
+    printf("       [-g game]\n");           // only this game
+    printf("       [-t turn]\n");           // only searches on this turn
+    printf("       [-x repeats]\n");        // run each search this often
+    mctsModelUsage();
+    printf("       log_file\n");
+    exit(1);
+}
+
+static uint32_t elapsedMs(struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint32_t)((now.tv_sec - start->tv_sec) * 1000 +
+                      (now.tv_usec - start->tv_usec) / 1000);
+}
+
+int main(int argc, char *argv[]) {
+    char *policyFile = NULL;
+    char *netFile = NULL;
+    int onlyGame = 0;
+    int onlyTurn = 0;
+    int repeats = 1;
+    int i = 1;
+
+    while (i < argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = TRUE;
+            ++i;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-g") == 0) {
+            onlyGame = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            onlyTurn = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-x") == 0) {
+            repeats = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-w") == 0) {
+            policyFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            netFile = argv[i + 1];
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (i + 1 != argc || repeats < 1) {
+        usage(argv[0]);
+    }
+    FILE *fp = fopen(argv[i], "r");
+    if (fp == NULL) {
+        perror(argv[i]);
+        return 1;
+    }
+
+    if (mctsLoadModels(policyFile, netFile) != 0) {
+        return 1;
+    }
+    fixedBudget = TRUE;
+    mctsConfig.adaptiveTime = FALSE;
+
+    char line[1024];
+    int game = 0;
+    int searches = 0;
+    int differ = 0;
+    uint64_t totalIterations = 0;
+    uint64_t totalMs = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "config ", 7) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            if (mctsConfigParse(&mctsConfig, line + 7)) {
+                fprintf(stderr, "Unknown setting in %s\n", line);
+                return 1;
+            }
+            continue;
+        }
+        if (sscanf(line, "game %d", &game) == 1 ||
+            strncmp(line, "search ", 7) != 0) {
+            continue;
+        }
+
+        State state;
+        int lastMove, move;
+        unsigned long long rng;
+        uint32_t iterations;
+        memset(&state, 0, sizeof(state));
+        if (sscanf(line,
+                   "search %d %d %d %d %x %x %x %x %x %x %x %x %x %llx %u %d",
+                   &moveNo, &lastMove, &state.subBoard, &state.playerLastMoved,
+                   &state.board[0], &state.board[1], &state.board[2],
+                   &state.board[3], &state.board[4], &state.board[5],
+                   &state.board[6], &state.board[7], &state.board[8], &rng,
+                   &iterations, &move) != 16) {
+            fprintf(stderr, "Bad search line: %s", line);
+            return 1;
+        }
+        if ((onlyGame && game != onlyGame) ||
+            (onlyTurn && moveNo != onlyTurn)) {
+            continue;
+        }
+        state.gameStatus = GAME_NOT_TERMINAL;
+        state.opponent = state.playerLastMoved;
+        state.me = 3 - state.playerLastMoved;
+        // The solver answers with 0, give the search its usual cap.
+        maxIterations = iterations ? iterations : MAXITER;
+
+        for (int r = 0; r < repeats; r++) {
+            struct timeval start;
+            rngState = rng;
+            confidence = 0.5;
+            gettimeofday(&start, NULL);
+            int got = run_mcts(&state, (Move)lastMove, 0);
+            uint32_t ms = elapsedMs(&start);
+            int same = got == move && mctsStats.iterations == iterations;
+            searches++;
+            differ += !same;
+            totalIterations += mctsStats.iterations;
+            totalMs += ms;
+            printf("game %d T:%d move %d iters %u %ums %s", game, moveNo, got,
+                   mctsStats.iterations, ms, same ? "OK\n" : "DIFF");
+            if (!same) {
+                printf(" (logged move %d iters %u)\n", move, iterations);
+            }
+        }
+    }
+    fclose(fp);
+
+    printf("%d searches, %d differ, %lu iterations in %lums", searches,
+           differ, (unsigned long)totalIterations, (unsigned long)totalMs);
+    if (totalMs > 0) {
+        printf(" (%.0lf/sec)", 1000.0 * totalIterations / totalMs);
+    }
+    printf("\n");
+    return differ != 0;
+}
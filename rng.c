@@ -0,0 +1,13 @@
+#include "rng.h"
+
+// Never 0, xorshift would stay there.
+__thread uint64_t rngState = 0x9e3779b97f4a7c15ull;
+
+void rngSeed(uint64_t seed) {
+    // splitmix64 finaliser.
+    seed += 0x9e3779b97f4a7c15ull;
+    seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+    seed ^= seed >> 31;
+    rngState = seed ? seed : 0x9e3779b97f4a7c15ull;
+}
@@ -0,0 +1,23 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stdint.h>
+
+/* Random numbers for the search: xorshift64*, a few cycles a call against
+ * rand()'s locked state in libc. The whole state is the one word below, so a
+ * search can be logged and replayed bit for bit from the value it started
+ * with. One per thread, see batch.h. */
+
+extern __thread uint64_t rngState;
+
+// Any seed is fine, it's scrambled so nearby seeds give unrelated streams.
+void rngSeed(uint64_t seed);
+
+static inline uint32_t rngNext(void) {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (uint32_t)((rngState * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+#endif
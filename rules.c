@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "game.h"
+#include "rules.h"
+
+/* winSquares[p] is the set of squares that would complete a line if added to
+ * the 9 bit pattern p. Generated offline, saves looping over the lines. */
+static const uint16_t winSquares[512] = {
+    0x000, 0x000, 0x000, 0x004, 0x000, 0x002, 0x001, 0x1ff,
+    0x000, 0x040, 0x000, 0x044, 0x000, 0x042, 0x001, 0x1ff,
+    0x000, 0x100, 0x080, 0x184, 0x040, 0x142, 0x0c1, 0x1ff,
+    0x020, 0x160, 0x0a0, 0x1e4, 0x060, 0x162, 0x0e1, 0x1ff,
+    0x000, 0x000, 0x000, 0x004, 0x100, 0x102, 0x101, 0x1ff,
+    0x010, 0x050, 0x010, 0x054, 0x110, 0x152, 0x111, 0x1ff,
+    0x008, 0x108, 0x088, 0x18c, 0x148, 0x14a, 0x1c9, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x000, 0x008, 0x000, 0x00c, 0x010, 0x01a, 0x011, 0x1ff,
+    0x001, 0x1ff, 0x001, 0x1ff, 0x011, 0x1ff, 0x011, 0x1ff,
+    0x004, 0x10c, 0x084, 0x18c, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x025, 0x1ff, 0x0a5, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x000, 0x008, 0x000, 0x00c, 0x110, 0x11a, 0x111, 0x1ff,
+    0x011, 0x1ff, 0x011, 0x1ff, 0x111, 0x1ff, 0x111, 0x1ff,
+    0x00c, 0x10c, 0x08c, 0x18c, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x000, 0x000, 0x010, 0x014, 0x000, 0x002, 0x011, 0x1ff,
+    0x000, 0x040, 0x010, 0x054, 0x000, 0x042, 0x011, 0x1ff,
+    0x002, 0x102, 0x1ff, 0x1ff, 0x042, 0x142, 0x1ff, 0x1ff,
+    0x022, 0x162, 0x1ff, 0x1ff, 0x062, 0x162, 0x1ff, 0x1ff,
+    0x000, 0x000, 0x010, 0x014, 0x100, 0x102, 0x111, 0x1ff,
+    0x010, 0x050, 0x010, 0x054, 0x110, 0x152, 0x111, 0x1ff,
+    0x00a, 0x10a, 0x1ff, 0x1ff, 0x14a, 0x14a, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x100, 0x108, 0x110, 0x11c, 0x110, 0x11a, 0x111, 0x1ff,
+    0x101, 0x1ff, 0x111, 0x1ff, 0x111, 0x1ff, 0x111, 0x1ff,
+    0x106, 0x10e, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x127, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x100, 0x108, 0x110, 0x11c, 0x110, 0x11a, 0x111, 0x1ff,
+    0x111, 0x1ff, 0x111, 0x1ff, 0x111, 0x1ff, 0x111, 0x1ff,
+    0x10e, 0x10e, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x000, 0x010, 0x000, 0x014, 0x020, 0x032, 0x021, 0x1ff,
+    0x000, 0x050, 0x000, 0x054, 0x020, 0x072, 0x021, 0x1ff,
+    0x001, 0x1ff, 0x081, 0x1ff, 0x061, 0x1ff, 0x0e1, 0x1ff,
+    0x021, 0x1ff, 0x0a1, 0x1ff, 0x061, 0x1ff, 0x0e1, 0x1ff,
+    0x004, 0x014, 0x004, 0x014, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x014, 0x054, 0x014, 0x054, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x00d, 0x1ff, 0x08d, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x080, 0x098, 0x080, 0x09c, 0x0b0, 0x0ba, 0x0b1, 0x1ff,
+    0x081, 0x1ff, 0x081, 0x1ff, 0x0b1, 0x1ff, 0x0b1, 0x1ff,
+    0x085, 0x1ff, 0x085, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x0a5, 0x1ff, 0x0a5, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x084, 0x09c, 0x084, 0x09c, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x095, 0x1ff, 0x095, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x08d, 0x1ff, 0x08d, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x040, 0x050, 0x050, 0x054, 0x060, 0x072, 0x071, 0x1ff,
+    0x040, 0x050, 0x050, 0x054, 0x060, 0x072, 0x071, 0x1ff,
+    0x043, 0x1ff, 0x1ff, 0x1ff, 0x063, 0x1ff, 0x1ff, 0x1ff,
+    0x063, 0x1ff, 0x1ff, 0x1ff, 0x063, 0x1ff, 0x1ff, 0x1ff,
+    0x044, 0x054, 0x054, 0x054, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x054, 0x054, 0x054, 0x054, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x04f, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+    0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff, 0x1ff,
+};
+
+State *initState(int board, int prev_move, int first_move) {
+    State *newState = calloc(1, sizeof(State));
+    newState->gameStatus = GAME_NOT_TERMINAL;
+    newState->subBoard = prev_move;
+
+    if (first_move == -1) {
+        newState->me = CIRCLE_PLAYER;
+        newState->board[board] = CROSS_PLAYER_START << prev_move;
+        newState->playerLastMoved = CROSS_PLAYER;
+    } else {
+        newState->me = CROSS_PLAYER;
+        newState->board[board] = CROSS_PLAYER_START << first_move;
+        newState->board[first_move] |= CIRCLE_PLAYER_START << prev_move;
+        newState->playerLastMoved = CIRCLE_PLAYER;
+    }
+
+    newState->opponent = 3 - newState->me;
+    return newState;
+}
+
+void stateDoMove(State *state, Move move) {
+    uint32_t moveMaker = 3u - state->playerLastMoved;
+    int prevBoard = state->subBoard;
+    /* In this case, the branching resulting from the ternary operation would
+     * likely produce less latency compared to the bitwise arithmetic approach
+     * commented out as IMUL instructions need to be set up and are as heavy as
+     * a branch instruction itself.*/
+    state->board[state->subBoard] |= moveMaker == CIRCLE_PLAYER
+                                         ? CIRCLE_PLAYER_START << move
+                                         : CROSS_PLAYER_START << move;
+    // |= (CIRCLE_PLAYER_START << 9u * (moveMaker- 1u)) << move;
+    state->subBoard = move;
+    state->playerLastMoved = moveMaker;
+    state->gameStatus = stateResult(state, moveMaker, prevBoard);
+}
+
+void stateStart(State *state, int board, int player) {
+    memset(state, 0, sizeof(State));
+    state->gameStatus = GAME_NOT_TERMINAL;
+    state->subBoard = board;
+    state->me = player;
+    state->opponent = 3 - player;
+    state->playerLastMoved = 3 - player;
+}
+
+int stateLegal(State *state, int move) {
+    uint32_t board = state->board[state->subBoard];
+    return state->gameStatus == GAME_NOT_TERMINAL && move >= 0 &&
+           move < BOARD_SIZE &&
+           !((board | (board >> 9u)) & (CIRCLE_PLAYER_START << move));
+}
+
+int statePlay(State *state, int move) {
+    if (!stateLegal(state, move)) {
+        return ILLEGAL_MOVE;
+    }
+    stateDoMove(state, (Move)move);
+    if (state->gameStatus == GAME_WON) {
+        return WIN;
+    } else if (state->gameStatus == GAME_LOST) {
+        return LOSS;
+    } else if (state->gameStatus == GAME_DRAWN) {
+        return DRAW;
+    }
+    return STILL_PLAYING;
+}
+
+void stateGetMoves(State *state, Move moves[BOARD_SIZE], uint32_t *numMoves) {
+    uint32_t subBoard = state->board[state->subBoard];
+    uint32_t mask = CIRCLE_PLAYER_START + CROSS_PLAYER_START;
+    int n = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        // If Circle or Cross doesn't have a move in that square...
+        if (!(subBoard & mask)) {
+            moves[n] = i;
+            ++n;
+        }
+        mask = mask << 1;
+    }
+    *numMoves = n;
+}
+
+// EVIL BIT LEVEL OPTIMIZATION.
+uint32_t isBoardFull(uint32_t board) {
+    // Optimize for as little branching as possible.
+    uint32_t circles = board & ALL_CIRCLES_MASK;
+    uint32_t crosses = (board & ALL_CROSSES_MASK) >> 9u;
+    return (circles | crosses) == ALL_CIRCLES_MASK;
+}
+
+// EVIL BIT LEVEL OPTIMIZATION BUT WORSE.
+uint32_t isGameWon(uint32_t board, uint32_t p) {
+    /* Could alternatively use a tree like approach to this, checking squares
+     * 0, 4, 8, could be more efficient as the worst case branching would be
+     * better.*/
+    --p;
+    board = board >> (9u * p);
+    return ((board & ROW0) == ROW0 || (board & ROW1) == ROW1 ||
+            (board & ROW2) == ROW2 || (board & COL0) == COL0 ||
+            (board & COL1) == COL1 || (board & COL2) == COL2 ||
+            (board & DIA0) == DIA0 || (board & DIA1) == DIA1);
+}
+
+uint32_t stateThreats(uint32_t board, int player) {
+    uint32_t own = (board >> (9u * (player - 1))) & ALL_CIRCLES_MASK;
+    uint32_t taken = (board | (board >> 9u)) & ALL_CIRCLES_MASK;
+    return winSquares[own] & ~taken;
+}
+
+uint32_t stateEmptySquares(State *state) {
+    uint32_t empty = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        uint32_t taken = (state->board[i] | (state->board[i] >> 9u)) &
+                         ALL_CIRCLES_MASK;
+        empty += BOARD_SIZE - __builtin_popcount(taken);
+    }
+    return empty;
+}
+
+double stateResult(State *state, int player, int prevBoard) {
+    uint32_t subBoard = state->board[prevBoard];
+
+    if (isGameWon(subBoard, player)) {
+        return GAME_WON;
+    } else if (isGameWon(subBoard, 3 - player)) {
+        return GAME_LOST;
+    } else if (isBoardFull(state->board[state->subBoard])) {
+        return GAME_DRAWN;
+    }
+
+    return GAME_NOT_TERMINAL;
+}
+
+// Index into print_board's sb: 0 X, 1 O, 2 empty.
+static int squareMark(uint32_t board, int square) {
+    if (board & (CIRCLE_PLAYER_START << square)) {
+        return 1;
+    } else if (board & (CROSS_PLAYER_START << square)) {
+        return 0;
+    }
+    return EMPTY;
+}
+
+void statePrint(FILE *fp, State *state, int board, int square) {
+    int bd[10][10];
+    reset_board(bd);
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        for (int s = 0; s < BOARD_SIZE; s++) {
+            bd[b + 1][s + 1] = squareMark(state->board[b], s);
+        }
+    }
+    // Row and column 0 are never printed, they take the mark when there's no
+    // last move to show.
+    bd[0][0] = EMPTY;
+    if (board < 0 || board >= BOARD_SIZE || square < 0 ||
+        square >= BOARD_SIZE || bd[board + 1][square + 1] == EMPTY) {
+        board = square = -1;
+    }
+    print_board(fp, bd, board + 1, square + 1);
+}
+
+int stateParse(const char *text, State *state) {
+    int lastBoard = -1;
+    int lastSquare = -1;
+    int n = 0;
+    const char *p;
+
+    stateStart(state, 0, CROSS_PLAYER);
+    for (p = text; *p != '\0' && n < BOARD_SIZE * BOARD_SIZE; p++) {
+        const char *mark = memchr(sb, *p, sizeof(sb));
+        if (mark == NULL) {
+            continue;
+        }
+        // n counts squares in print order, three sub-boards to a line.
+        int line = n / 9;
+        int board = 3 * (line / 3) + (n % 9) / 3;
+        int square = 3 * (line % 3) + n % 3;
+        int player = (mark - sb) % 3;
+        if (player == 0) {
+            state->board[board] |= CROSS_PLAYER_START << square;
+        } else if (player == 1) {
+            state->board[board] |= CIRCLE_PLAYER_START << square;
+        }
+        if (mark - sb >= 3) {
+            if (lastBoard >= 0) {
+                return -1;
+            }
+            lastBoard = board;
+            lastSquare = square;
+        }
+        n++;
+    }
+    if (n < BOARD_SIZE * BOARD_SIZE || lastBoard < 0) {
+        return -1;
+    }
+    int lastPlayer = (state->board[lastBoard] >> lastSquare) & 1
+                         ? CIRCLE_PLAYER
+                         : CROSS_PLAYER;
+    state->subBoard = lastSquare;
+    state->playerLastMoved = lastPlayer;
+    state->me = 3 - lastPlayer;
+    state->opponent = lastPlayer;
+    state->gameStatus = stateResult(state, lastPlayer, lastBoard);
+    return (int)(p - text);
+}
+
+void printBoard(State *state) {
+    statePrint(stdout, state, -1, -1);
+}
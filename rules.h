@@ -0,0 +1,94 @@
+#ifndef __RULES_H__
+#define __RULES_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Nine-board rules on bitboards, shared by the search, the agents, the
+ * server and the tools. Squares and sub-boards are numbered 0-8 here, the
+ * protocol's 1-9 minus one. */
+
+#define EMPTY_SQUARE 0
+#define CIRCLE_PLAYER 1
+#define CROSS_PLAYER 2
+#define BOARD_SIZE 9
+#define GAME_NOT_TERMINAL -1.0
+#define GAME_LOST 0.0
+#define GAME_WON 1.0
+#define GAME_DRAWN 0.5
+
+// Scary bit constants below
+#define CROSS_PLAYER_START 0x00000200
+#define CIRCLE_PLAYER_START 0x00000001
+#define ALL_CIRCLES_MASK 0x000001ff
+// 0x1ff << 9
+#define ALL_CROSSES_MASK 0x0003fe00
+// wtf
+#define ROW0 0x00000007
+#define ROW1 0x00000038
+#define ROW2 0x000001c0
+#define COL0 0x00000049
+#define COL1 0x00000092
+#define COL2 0x00000124
+#define DIA0 0x00000111
+#define DIA1 0x00000054
+
+typedef uint8_t Move;
+
+// Game state.
+typedef struct state {
+    // GAME_NOT_TERMINAL/LOST/WON/DRAWN
+    double gameStatus;
+    // CIRCLE_PLAYER/CROSS_PLAYER
+    int opponent;
+    int me;
+    int playerLastMoved;
+    // Which sub-board the game is currently on.
+    int subBoard;
+    /* Each subboard is divided into 2 9 bit sections. Starting with the least 9
+     * bits for Circle and then the nex 9 for Cross. */
+    uint32_t board[BOARD_SIZE];
+} State;
+
+/* The position after the opening move(s) the server hands an agent, with
+ * the agent to move. first_move is -1 when the agent moves second. */
+State *initState(int board, int prev_move, int first_move);
+/* Empty board with player (CIRCLE_PLAYER/CROSS_PLAYER) to move on board, for
+ * refereeing a game from its first move. */
+void stateStart(State *state, int board, int player);
+// Move must be legal, see stateLegal.
+void stateDoMove(State *state, Move move);
+// TRUE if the player to move may play move.
+int stateLegal(State *state, int move);
+/* stateDoMove for moves from outside: returns ILLEGAL_MOVE and leaves state
+ * alone if move isn't legal, otherwise WIN, DRAW or STILL_PLAYING for the
+ * player who made it, as in common.h. */
+int statePlay(State *state, int move);
+/* Result of the last move for player, who made it on prevBoard: a line on
+ * that board wins, otherwise being sent to a full board is a draw. */
+double stateResult(State *state, int player, int prevBoard);
+// Fills moves with the empty squares of the current sub-board.
+void stateGetMoves(State *state, Move moves[BOARD_SIZE], uint32_t *numMoves);
+/* Mask of empty squares on a sub-board where player would complete a line,
+ * bit n for square n. */
+uint32_t stateThreats(uint32_t board, int player);
+// Number of empty squares left across all sub-boards.
+uint32_t stateEmptySquares(State *state);
+
+uint32_t isBoardFull(uint32_t board);
+// TRUE if player p has a line on this sub-board.
+uint32_t isGameWon(uint32_t board, uint32_t p);
+
+/* Same output as the provided print_board, crosses as X and circles as O,
+ * with the last move on (board, square) in lower case. -1 for no last
+ * move. */
+void statePrint(FILE *fp, State *state, int board, int square);
+/* Reads a board in statePrint's layout, anything other than X, O, x, o and
+ * . is skipped. The lower case mark is taken as the last move and decides
+ * the sub-board and who is to move. Returns the number of characters used,
+ * or -1 if there weren't 81 squares with exactly one lower case mark. */
+int stateParse(const char *text, State *state);
+// Hacky adapter to provided print_board function.
+void printBoard(State *state);
+
+#endif
@@ -0,0 +1,132 @@
+/* Search worker for root parallel search (see dist.h).
+ *
+ * Listens on a TCP port or a Unix socket path and answers search requests
+ * from one coordinating agent at a time, the agent connects with -W. Give it
+ * the same weights files as the agent.
+ *
+ * Example, two workers for an agent on this machine:
+ * ./searchd -p 40001 &
+ * ./searchd -u /tmp/searchd.sock &
+ * ./agent -p 12345 -W localhost:40001 -W unix:/tmp/searchd.sock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "dist.h"
+#include "nn.h"
+#include "policy.h"
+#include "rng.h"
+
+// Used by the linked in search code.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       -v");
+    printf("       [-p port]\n");         // tcp port
+    printf("       [-u socket_path]\n");  // or a unix socket
+    printf("       [-w policy_file]\n");  // rollout policy weights
+    printf("       [-m network_file]\n");  // value/policy network
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int port = 0;
+    char *path = NULL;
+    int listenFd;
+    int i = 1;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = TRUE;
+            ++i;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            port = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-u") == 0) {
+            path = argv[i + 1];
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (policyLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load policy %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-m") == 0) {
+            if (nnLoad(argv[i + 1]) != 0) {
+                fprintf(stderr, "Couldn't load network %s\n", argv[i + 1]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if ((port == 0) == (path == NULL)) {
+        usage(argv[0]);
+    }
+
+    if (path != NULL) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        unlink(path);
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 ||
+            bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("searchd: bind");
+            return 1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        int one = 1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd >= 0) {
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+        if (listenFd < 0 ||
+            bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("searchd: bind");
+            return 1;
+        }
+    }
+    if (listen(listenFd, 1) != 0) {
+        perror("searchd: listen");
+        return 1;
+    }
+
+    rngSeed(((uint64_t)getpid() << 32) ^ (uint64_t)time(NULL));
+    for (;;) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            perror("searchd: accept");
+            continue;
+        }
+        if (verbose) {
+            fprintf(stderr, "searchd: coordinator connected\n");
+        }
+        distServe(fd);
+        close(fd);
+        if (verbose) {
+            fprintf(stderr, "searchd: coordinator gone\n");
+        }
+    }
+    return 0;
+}
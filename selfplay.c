@@ -0,0 +1,196 @@
+/* Self-play training data generator.
+ *
+ * Plays games with run_mcts at a fixed iteration budget on one worker
+ * process per core and streams a Record (see record.h) for every position
+ * searched to that worker's shard, prefix-NNN.bin. Records go out a game at a
+ * time once the result is known, so the shards can be read while they grow.
+ * nettrain and policytrain take the shards with -d, recread summarises or
+ * dumps them.
+ *
+ * Example:
+ * ./selfplay -o data/run1 -g 20000 -i 3000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "record.h"
+#include "rng.h"
+
+#define DEFAULT_SELFPLAY_GAMES 1000
+#define DEFAULT_SELFPLAY_ITERATIONS 3000
+// Longest game, one move per square.
+#define MAX_GAME_PLIES 81
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-o shard_prefix]\n");
+    printf("       [-g games]\n");
+    printf("       [-i iterations]\n");     // per move
+    printf("       [-x random_plies]\n");   // after the opening, for variety
+    printf("       [-j workers]\n");
+    printf("       [-c name=value,...]\n");  // search settings
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+// Plays one game and appends its records to fp, returns how many.
+static int playGame(FILE *fp, int randomPlies) {
+    static Record records[MAX_GAME_PLIES];
+    State *state = initState(rand() % 9, rand() % 9, -1);
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    int n = 0;
+    moveNo = 2;
+    confidence = 0.5;
+
+    for (int p = 0; p < randomPlies && state->gameStatus == GAME_NOT_TERMINAL;
+         p++) {
+        stateGetMoves(state, moves, &nMoves);
+        stateDoMove(state, moves[(uint32_t)rand() % nMoves]);
+        moveNo++;
+    }
+    while (state->gameStatus == GAME_NOT_TERMINAL) {
+        Move move = run_mcts(state, state->subBoard, 60000);
+        recordPack(&records[n++], state, mctsStats.rootVisits, confidence,
+                   moveNo);
+        // The solver answers without a tree, record its move as all visits.
+        if (mctsStats.iterations == 0) {
+            records[n - 1].visits[move] = 1;
+        }
+        stateDoMove(state, move);
+        moveNo++;
+    }
+
+    int winner = 0;
+    if (state->gameStatus == GAME_WON) {
+        winner = state->playerLastMoved;
+    } else if (state->gameStatus == GAME_LOST) {
+        winner = 3 - state->playerLastMoved;
+    }
+    for (int r = 0; r < n; r++) {
+        records[r].result = winner == 0                    ? RECORD_DRAW
+                            : winner == records[r].toMove ? RECORD_WIN
+                                                          : RECORD_LOSS;
+    }
+    free(state);
+    if (n > 0 && (fwrite(records, sizeof(Record), n, fp) != (size_t)n ||
+                  fflush(fp) != 0)) {
+        perror("selfplay: writing shard");
+        _exit(1);
+    }
+    return n;
+}
+
+static void selfPlayWorker(int worker, int numWorkers, int games,
+                           int randomPlies, const char *prefix,
+                           unsigned int seed, uint64_t *positions) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s-%03d.bin", prefix, worker);
+    FILE *fp = recordCreate(path);
+    if (fp == NULL) {
+        perror(path);
+        _exit(1);
+    }
+    srand(seed + worker);
+    rngSeed(seed + worker);
+    for (int g = worker; g < games; g += numWorkers) {
+        positions[worker] += playGame(fp, randomPlies);
+        if (worker == 0) {
+            uint64_t total = 0;
+            for (int w = 0; w < numWorkers; w++) {
+                total += positions[w];
+            }
+            fprintf(stderr, "\rselfplay: ~%d/%d games, %lu positions", g + 1,
+                    games, (unsigned long)total);
+        }
+    }
+    fclose(fp);
+}
+
+int main(int argc, char *argv[]) {
+    char *prefix = DEFAULT_RECORD_PREFIX;
+    int games = DEFAULT_SELFPLAY_GAMES;
+    int randomPlies = 0;
+    int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int seed = 1;
+    int i = 1;
+
+    maxIterations = DEFAULT_SELFPLAY_ITERATIONS;
+    mctsConfig.adaptiveTime = FALSE;
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            prefix = argv[i + 1];
+        } else if (strcmp(argv[i], "-g") == 0) {
+            games = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-x") == 0) {
+            randomPlies = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            numWorkers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            if (mctsConfigParse(&mctsConfig, argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (numWorkers < 1) {
+        numWorkers = 1;
+    }
+
+    // Position counts per worker, shared for the progress line and summary.
+    uint64_t *positions =
+        mmap(NULL, numWorkers * sizeof(uint64_t), PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (positions == MAP_FAILED) {
+        perror("selfplay: mmap");
+        return 1;
+    }
+    memset(positions, 0, numWorkers * sizeof(uint64_t));
+
+    fflush(stdout);
+    for (int w = 0; w < numWorkers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("selfplay: fork");
+            return 1;
+        } else if (pid == 0) {
+            selfPlayWorker(w, numWorkers, games, randomPlies, prefix, seed,
+                           positions);
+            _exit(0);
+        }
+    }
+    int failed = 0;
+    int status;
+    while (wait(&status) > 0) {
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    fprintf(stderr, "\n");
+
+    uint64_t total = 0;
+    for (int w = 0; w < numWorkers; w++) {
+        total += positions[w];
+    }
+    printf("Wrote %lu positions from %d games to %s-000.bin..%s-%03d.bin\n",
+           (unsigned long)total, games, prefix, prefix, numWorkers - 1);
+    return failed;
+}
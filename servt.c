@@ -7,27 +7,52 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 #include <arpa/inet.h> 
 #include <netinet/tcp.h>
 #include <unistd.h>
 
 #include "common.h"
 #include "game.h"
+#include "proto.h"
+#include "rules.h"
 
 #define  MAX_MOVE              81
+  // latency histogram buckets, bucket k is [2^k,2^(k+1)) usec
+#define  LATENCY_BUCKETS       24
 
 FILE *agent_in[2];
-FILE *agent_out[2];
+ProtoReader agent_out[2];
 int   agent_fd[2];
 int  msec_left[2];
 int   is_human[2]={FALSE,FALSE};
+  // agents we start ourselves on a socketpair, instead of over tcp
+char *agent_command[2]={NULL,NULL};
+pid_t agent_pid[2]={0,0};
 
   // allow 30 secons initially, plus 2 seconds for each move
 int seconds_initially = 30;
 int seconds_per_move  =  2;
 
+  // timing of one agent move on the monotonic clock, in usec
+typedef struct move_time {
+  int  game;
+  int  move;
+  long send_us;   // request flushed to the agent
+  long recv_us;   // reply read back
+  long think_us;  // as reported by the agent, -1 if it didn't
+} move_time;
+
+int   report_latency = FALSE;
+FILE *latency_fp = NULL;
+int   game_num;
+move_time *move_times[2];
+int   num_move_times[2];
+int   max_move_times[2];
+
 
 /*********************************************************//*
    Write message to specified player
@@ -51,6 +76,177 @@ void write_all(char *str)
   }
 }
 
+/*********************************************************//*
+   Monotonic clock in usec
+*/
+long usec_now()
+{
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC,&ts );
+  return( ts.tv_sec*1000000L + ts.tv_nsec/1000 );
+}
+
+/*********************************************************//*
+   Keep the timing of one agent move, and log it if asked
+*/
+void record_move_time(
+                      int player,
+                      int m,
+                      long send_us,
+                      long recv_us,
+                      long think_us
+                     )
+{
+  move_time *t;
+  if( num_move_times[player] == max_move_times[player] ) {
+    max_move_times[player] = max_move_times[player] ? 2*max_move_times[player]
+                                                    : 256;
+    move_times[player] = realloc( move_times[player],
+                           max_move_times[player]*sizeof(move_time));
+    if( move_times[player] == NULL ) {
+      perror("cannot record move times ");
+      exit(1);
+    }
+  }
+  t = &move_times[player][num_move_times[player]++];
+  t->game     = game_num;
+  t->move     = m;
+  t->send_us  = send_us;
+  t->recv_us  = recv_us;
+  t->think_us = think_us;
+  if( latency_fp != NULL ) {
+    fprintf(latency_fp,"%d %d %c %ld %ld %ld\n",game_num,m,sb[player],
+            send_us,recv_us,think_us);
+  }
+}
+
+/*********************************************************//*
+   Sort helper for the percentiles
+*/
+int compare_long( const void *a, const void *b )
+{
+  long x = *(const long *)a;
+  long y = *(const long *)b;
+  return(( x > y ) - ( x < y ));
+}
+
+/*********************************************************//*
+   Print percentiles and a log2 histogram of n values in usec
+*/
+void print_latency( char *name, long v[], int n )
+{
+  int  hist[LATENCY_BUCKETS]={0};
+  int  i,k,most=0;
+  long sum=0;
+  if( n == 0 ) {
+    return;
+  }
+  qsort( v,n,sizeof(long),compare_long );
+  for( i=0; i < n; i++ ) {
+    sum += v[i];
+    k = 0;
+    while( k < LATENCY_BUCKETS-1 && v[i] >= (2L << k)) {
+      k++;
+    }
+    hist[k]++;
+    if( hist[k] > most ) {
+      most = hist[k];
+    }
+  }
+  printf("  %-10s n %5d  mean %8ld  p50 %8ld  p90 %8ld  p99 %8ld  max %8ld\n",
+         name,n,sum/n,v[(n-1)*50/100],v[(n-1)*90/100],v[(n-1)*99/100],
+         v[n-1]);
+  for( k=0; k < LATENCY_BUCKETS; k++ ) {
+    if( hist[k] > 0 ) {
+      printf("    %8ld-%-8ld %5d ",k ? 1L << k : 0L,(2L << k)-1,hist[k]);
+      for( i=0; i < (40*hist[k]+most-1)/most; i++ ) {
+        putchar('#');
+      }
+      putchar('\n');
+    }
+  }
+}
+
+/*********************************************************//*
+   Report each agent's move latency over the match, in usec:
+   round trip from request to reply, think time reported by
+   the agent and the overhead between the two
+*/
+void report_latencies()
+{
+  int player,i,n;
+  long *round_trip,*think,*overhead;
+  for( player=0; player < 2; player++ ) {
+    if( is_human[player] || num_move_times[player] == 0 ) {
+      continue;
+    }
+    round_trip = malloc( num_move_times[player]*sizeof(long));
+    think      = malloc( num_move_times[player]*sizeof(long));
+    overhead   = malloc( num_move_times[player]*sizeof(long));
+    n = 0;
+    for( i=0; i < num_move_times[player]; i++ ) {
+      move_time *t = &move_times[player][i];
+      round_trip[i] = t->recv_us - t->send_us;
+      if( t->think_us >= 0 ) {
+        think[n]    = t->think_us;
+        overhead[n] = round_trip[i] - t->think_us;
+        n++;
+      }
+    }
+    printf("Player %c latency (usec)\n",sb[player]);
+    print_latency( "round_trip",round_trip,num_move_times[player] );
+    print_latency( "think",think,n );
+    print_latency( "overhead",overhead,n );
+    free( round_trip );
+    free( think );
+    free( overhead );
+  }
+  printf("\n");
+}
+
+/*********************************************************//*
+   Talk to player i over fd from now on
+*/
+void connect_agent( int i, int fd )
+{
+  agent_fd[i] = fd;
+  agent_in[i] = fdopen(fd,"w");
+  protoInit( &agent_out[i],fd );
+}
+
+/*********************************************************//*
+   Start player i's command with our end of a socketpair
+   as its stdin and stdout, no port needed
+*/
+void spawn_agent( int i )
+{
+  int fds[2];
+  if( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0 ) {
+    perror("cannot create socketpair ");
+    exit(1);
+  }
+  fflush(stdout);
+  agent_pid[i] = fork();
+  if( agent_pid[i] < 0 ) {
+    perror("cannot fork ");
+    exit(1);
+  }
+  if( agent_pid[i] == 0 ) {
+    close(fds[0]);
+    if( agent_fd[!i] > 0 ) {
+      close(agent_fd[!i]);
+    }
+    dup2(fds[1], 0);
+    dup2(fds[1], 1);
+    close(fds[1]);
+    execl("/bin/sh", "sh", "-c", agent_command[i], (char *)NULL);
+    perror( agent_command[i] );
+    _exit(127);
+  }
+  close(fds[1]);
+  connect_agent( i,fds[0] );
+}
+
 /*********************************************************//*
    Set up network connection(s)
 */
@@ -60,6 +256,20 @@ void server_init( int port )
   
   struct sockaddr_in servAddr;
 
+  for(i = 0; i < 2; i++) {
+    if( agent_command[i] != NULL ) {
+      spawn_agent( i );
+    }
+  }
+  if(( is_human[0] || agent_command[0] != NULL )
+   &&( is_human[1] || agent_command[1] != NULL )) {
+    write_all("init.\n");
+    if( report_latency ) {
+      write_all("think_time.\n");
+    }
+    return;
+  }
+
   // create socket
   server = socket(AF_INET, SOCK_STREAM, 0);
   if( server < 0 ) {
@@ -93,7 +303,7 @@ void server_init( int port )
   
   // accept client connections
   for(i = 0; i < 2; i++) {
-    if( !is_human[i] ) {
+    if( !is_human[i] && agent_command[i] == NULL ) {
       int tcp_no_delay = 1;
       client = accept(server, NULL, NULL);
       if( client < 0 ) {
@@ -106,9 +316,7 @@ void server_init( int port )
         exit(1);
       }
 
-      agent_fd[i]  = client;
-      agent_in[i]  = fdopen(client,"w");
-      agent_out[i] = fdopen(client,"r");
+      connect_agent( i,client );
     }
   }
   printf("\n");
@@ -116,6 +324,22 @@ void server_init( int port )
   close(server);
 
   write_all("init.\n");
+  if( report_latency ) {
+    write_all("think_time.\n");
+  }
+}
+
+/*********************************************************//*
+   Make specified move and return game status
+*/
+int referee_move( int m, int move[], State *state )
+{
+  int game_status = statePlay( state,move[m]-1 );
+  if( game_status == ILLEGAL_MOVE ) {
+    printf("ILLEGAL MOVE detected on board %d. Move was %d\n", move[m-1], move[m]);
+    statePrint( stdout,state,move[m-2]-1,move[m-1]-1 );
+  }
+  return( game_status );
 }
 
 /*********************************************************//*
@@ -125,12 +349,12 @@ int human_step(
                int player,
                int m,
                int move[],
-               int board[10][10]
+               State *state
               )
 {
   char line[256];
   int c=0,i;
-  print_board( stdout,board,move[m-2],move[m-1] );
+  statePrint( stdout,state,move[m-2]-1,move[m-1]-1 );
   while( c == 0 && !feof(stdin)) {
     printf("next move for %c ? ",sb[player]);
     fgets(line,256,stdin);
@@ -140,13 +364,13 @@ int human_step(
       i++;
     if( i < 256 && line[i] != '\0' ) {
       c = line[i] - '0';
-      if( board[move[m-1]][c] != EMPTY ) {
+      if( !stateLegal( state,c-1 )) {
         c = 0;
       }
     }
   }
   move[m] = c;
-  return( make_move( player,m,move,board ));
+  return( referee_move( m,move,state ));
 }
 
 /*********************************************************//*
@@ -156,16 +380,14 @@ int server_step(
                 int player,
                 int m,
                 int move[],
-                int board[10][10]
+                State *state
                )
 {
   int game_status;
-  struct timeval tv;
-  struct timeval tod_start, tod_fin;
+  ProtoMessage reply;
+  long send_us, recv_us;
   int move_msec;
-  int move_scanned;
-  fd_set fds;
-  int i;
+  send_us = usec_now();
   if ( m == 2 ) { // second move
     fprintf(agent_in[player],"second_move(%d,%d).\n",
             move[0],move[1]);
@@ -179,28 +401,17 @@ int server_step(
   }
   fflush(agent_in[player]);
 
-  FD_ZERO(&fds);
-  FD_SET(agent_fd[player], &fds);
-
   msec_left[player] += 1000 * seconds_per_move;
 
-  memset(&tv, 0, sizeof(struct timeval));
-  tv.tv_sec = 1 + msec_left[player]/1000;
-
-  gettimeofday( &tod_start, NULL );
-  i = select(agent_fd[player] + 1, &fds, NULL, NULL, &tv);
-  if( i > 0 ) {
-    move_scanned = fscanf(agent_out[player], "%d", &move[m]);
-    gettimeofday( &tod_fin, NULL );
-    move_msec = 1 + (tod_fin.tv_sec -tod_start.tv_sec )*1000
-                  + (tod_fin.tv_usec-tod_start.tv_usec)/1000;
+  // the move, then the think time in usec if we asked for it
+  if( protoRead( &agent_out[player],&reply,
+                 1000 + msec_left[player] ) == MSG_MOVE ) {
+    recv_us = usec_now();
+    move_msec = 1 + (int)((recv_us - send_us)/1000);
     msec_left[player] -= move_msec;
-    if( move_scanned ) {
-      game_status = make_move( player,m,move,board );
-    }
-    else {
-      game_status = TIMEOUT;
-    }
+    move[m] = reply.args[0];
+    record_move_time( player,m,send_us,recv_us,reply.thinkUs );
+    game_status = referee_move( m,move,state );
   }
   else {
     game_status = TIMEOUT;
@@ -216,7 +427,7 @@ int server_step(
 */
 void play_games( int num_games, int move[] )
 {
-  int board[10][10];
+  State state;
   int game_status;
   int player, first_player;
   int game;
@@ -225,8 +436,7 @@ void play_games( int num_games, int move[] )
   first_player = 0;
 
   for( game=0; game < num_games; game++ ) {
-    reset_board( board );
-
+    game_num = game;
     write_agent( first_player,"start(x).\n");
     write_agent(!first_player,"start(o).\n");
 
@@ -239,23 +449,24 @@ void play_games( int num_games, int move[] )
     }
     m = 1;
     player = first_player;
-    game_status = make_move( player,m,move,board );
+    stateStart( &state,move[0]-1,player == 0 ? CROSS_PLAYER : CIRCLE_PLAYER );
+    game_status = referee_move( m,move,&state );
     while( m < MAX_MOVE && game_status == STILL_PLAYING ) {
-      //print_board( stdout,board,move[m-1],move[m] );
+      //statePrint( stdout,&state,move[m-1]-1,move[m]-1 );
       m++;
       player = !player;
       if( is_human[player] ) {
-        game_status =  human_step( player,m,move,board );
+        game_status =  human_step( player,m,move,&state );
       }
       else {
-        game_status = server_step( player,m,move,board );
+        game_status = server_step( player,m,move,&state );
       }
     }
     if(!is_human[!player] &&(game_status == WIN || game_status == DRAW)){
       fprintf(agent_in[!player],"last_move(%d).\n",move[m]);
     }
 
-    print_board( stdout,board,move[m-1],move[m] );
+    statePrint( stdout,&state,move[m-1]-1,move[m]-1 );
 
     if( game_status == WIN ) {
       write_agent(  player, "win(triple).\n" );
@@ -291,8 +502,11 @@ void cleanup()
     if( !is_human[i] ) {
       write_agent(i, "end.\n");
       fclose(agent_in[i]);
-      fclose(agent_out[i]);
-      close(agent_fd[i]);
+    }
+  }
+  for( i = 0; i < 2; i++) {
+    if( agent_pid[i] > 0 ) {
+      waitpid( agent_pid[i],NULL,0 );
     }
   }
 }    
@@ -304,11 +518,16 @@ void usage( char argv0[] )
 {
   printf("Usage: %s\n",argv0);
   printf("       [-x] [-o]\n");        // human plays X or O
+  // start the agent for X or O, talking over its stdin and stdout
+  printf("       [-X command] [-O command]\n");
   printf("       [-p port]\n");        // tcp port
   printf("       [-m board square]\n");// specify first move
   // number of seconds allocated initially, and per move
   printf("       [-t initial permove]\n");
   printf("       [-n num_games]\n");   // number of games
+  printf("       [-r seed]\n");        // for the random first moves
+  // latency report, and each agent move's timing to a file
+  printf("       [-l latency_file]\n");
   exit(1);
 }
 
@@ -319,6 +538,7 @@ int main(int argc, char *argv[])
   int move[MAX_MOVE+1]={0};
   int port=31415;
   int num_games=1;
+  int seed=-1;
   int i=1;
 
   while( i < argc ) {
@@ -337,6 +557,14 @@ int main(int argc, char *argv[])
       is_human[1] = TRUE;
       i++;
     }
+    else if( strcmp( argv[i], "-X" ) == 0
+          || strcmp( argv[i], "-O" ) == 0 ) {
+      if( i+1 >= argc ) {
+        usage( argv[0] );
+      }
+      agent_command[argv[i][1] == 'O'] = argv[i+1];
+      i += 2;
+    }
     else if( strcmp( argv[i], "-m" ) == 0 ) {
       if( i+2 >= argc ) {
         usage( argv[0] );
@@ -361,6 +589,26 @@ int main(int argc, char *argv[])
       }
       i += 3;
     }
+    else if( strcmp( argv[i], "-l" ) == 0 ) {
+      if( i+1 >= argc ) {
+        usage( argv[0] );
+      }
+      latency_fp = fopen(argv[i+1],"w");
+      if( latency_fp == NULL ) {
+        perror( argv[i+1] );
+        exit(1);
+      }
+      fprintf(latency_fp,"game move player send_us recv_us think_us\n");
+      report_latency = TRUE;
+      i += 2;
+    }
+    else if( strcmp( argv[i], "-r" ) == 0 ) {
+      if( i+1 >= argc ) {
+        usage( argv[0] );
+      }
+      seed = atoi(argv[i+1]);
+      i += 2;
+    }
     else if( strcmp( argv[i], "-n" ) == 0 ) {
       if( i+1 >= argc ) {
         usage( argv[0] );
@@ -373,14 +621,18 @@ int main(int argc, char *argv[])
     }
   }
 
-  // generate a new random seed each time
+  // generate a new random seed each time, unless given one
   gettimeofday( &tp, NULL );
-  srandom(( unsigned int )( tp.tv_usec ));
+  srandom( seed >= 0 ? ( unsigned int )seed : ( unsigned int )( tp.tv_usec ));
 
   if( !is_human[0] || !is_human[1] ) {
     server_init( port );
   }
   play_games( num_games,move );
+  if( report_latency ) {
+    report_latencies();
+    fclose( latency_fp );
+  }
 
   cleanup();
 
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "solver.h"
+
+#define TRUE 1
+#define FALSE 0
+
+// Check the clock and node budget every 4096 nodes.
+#define SOLVER_CLOCK_MASK 4095u
+#define TT_EXACT 1
+#define TT_LOWER 2
+#define TT_UPPER 3
+
+typedef struct ttEntry {
+    uint64_t key;
+    int8_t value;
+    uint8_t flag;
+    uint8_t move;
+} TTEntry;
+
+/* Allocated on first use and kept, entries stay valid from turn to turn.
+ * Each thread has its own so batch searches can solve side by side. */
+static __thread TTEntry *table = NULL;
+__thread uint64_t solverMaxNodes = 0;
+static __thread uint64_t nodes;
+static __thread int aborted;
+static __thread struct timespec deadline;
+
+static uint64_t stateHash(State *state) {
+    uint64_t h = (uint64_t)state->subBoard * 9 + state->playerLastMoved;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        h = (h ^ state->board[i]) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 29;
+    }
+    // 0 marks an empty slot.
+    return h | 1;
+}
+
+static int pastDeadline(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline.tv_sec ||
+           (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+}
+
+static int negamax(State *state, int alpha, int beta, Move *bestMove) {
+    if ((++nodes & SOLVER_CLOCK_MASK) == 0 &&
+        ((solverMaxNodes && nodes >= solverMaxNodes) || pastDeadline())) {
+        aborted = TRUE;
+    }
+    if (aborted) {
+        return SOLVER_DRAW;
+    }
+
+    int player = 3 - state->playerLastMoved;
+    uint32_t board = state->board[state->subBoard];
+
+    // Completing a line ends it, no need to look any further.
+    uint32_t wins = stateThreats(board, player);
+    if (wins) {
+        *bestMove = __builtin_ctz(wins);
+        return SOLVER_WIN;
+    }
+
+    uint64_t key = stateHash(state);
+    TTEntry *entry = &table[key & ((1u << SOLVER_TT_BITS) - 1)];
+    int origAlpha = alpha;
+    Move ttMove = BOARD_SIZE;
+    if (entry->key == key) {
+        ttMove = entry->move;
+        if (entry->flag == TT_EXACT ||
+            (entry->flag == TT_LOWER && entry->value >= beta) ||
+            (entry->flag == TT_UPPER && entry->value <= alpha)) {
+            *bestMove = entry->move;
+            return entry->value;
+        }
+    }
+
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    stateGetMoves(state, moves, &nMoves);
+    // Try the table's move first.
+    for (uint32_t i = 1; i < nMoves; i++) {
+        if (moves[i] == ttMove) {
+            moves[i] = moves[0];
+            moves[0] = ttMove;
+            break;
+        }
+    }
+
+    int best = SOLVER_LOSS - 1;
+    *bestMove = moves[0];
+    for (uint32_t i = 0; i < nMoves && alpha < beta; i++) {
+        State child = *state;
+        int value;
+        Move reply;
+        stateDoMove(&child, moves[i]);
+        if (child.gameStatus == GAME_DRAWN) {
+            value = SOLVER_DRAW;
+        } else if (stateThreats(child.board[child.subBoard], 3 - player)) {
+            // Sent them to a board they can finish straight away.
+            value = SOLVER_LOSS;
+        } else {
+            value = -negamax(&child, -beta, -alpha, &reply);
+            if (aborted) {
+                return SOLVER_DRAW;
+            }
+        }
+        if (value > best) {
+            best = value;
+            *bestMove = moves[i];
+        }
+        if (value > alpha) {
+            alpha = value;
+        }
+    }
+
+    entry->key = key;
+    entry->value = (int8_t)best;
+    entry->move = *bestMove;
+    entry->flag = best <= origAlpha ? TT_UPPER
+                  : best >= beta    ? TT_LOWER
+                                    : TT_EXACT;
+    return best;
+}
+
+int solveState(State *state, uint32_t maxMs, SolverResult *result) {
+    memset(result, 0, sizeof(SolverResult));
+    if (state->gameStatus != GAME_NOT_TERMINAL) {
+        return FALSE;
+    }
+    if (table == NULL) {
+        table = calloc(1u << SOLVER_TT_BITS, sizeof(TTEntry));
+        if (table == NULL) {
+            return FALSE;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += maxMs / 1000;
+    deadline.tv_nsec += (long)(maxMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    nodes = 0;
+    aborted = FALSE;
+
+    State root = *state;
+    Move move;
+    int outcome = negamax(&root, SOLVER_LOSS, SOLVER_WIN, &move);
+
+    result->nodes = nodes;
+    if (aborted) {
+        return FALSE;
+    }
+    result->solved = TRUE;
+    result->move = move;
+    result->outcome = outcome;
+    return TRUE;
+}
+
+void solverClear(void) {
+    if (table != NULL) {
+        memset(table, 0, (1u << SOLVER_TT_BITS) * sizeof(TTEntry));
+    }
+}
+
+void solverCleanup(void) {
+    free(table);
+    table = NULL;
+}
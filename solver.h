@@ -0,0 +1,47 @@
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Exact endgame solver. Plain negamax alpha-beta over State with a
+ * transposition table, values are from the viewpoint of the player to move:
+ * 1 win, 0 draw, -1 loss. Once few enough squares are left run_mcts tries it
+ * first and only falls back to playouts if it can't finish in time. */
+
+// run_mcts tries the solver once this few empty squares remain.
+#define SOLVER_MAX_EMPTY 45
+// Fraction of the turn the solver may use before we give up on it.
+#define SOLVER_TIME_DIVISOR 4
+// log2 of the number of transposition table entries, 16 bytes each.
+#define SOLVER_TT_BITS 20
+
+#define SOLVER_LOSS -1
+#define SOLVER_DRAW 0
+#define SOLVER_WIN 1
+
+typedef struct solverResult {
+    // TRUE if the search finished and move/outcome are proven.
+    int solved;
+    Move move;
+    // SOLVER_WIN/DRAW/LOSS for the player to move.
+    int outcome;
+    uint64_t nodes;
+} SolverResult;
+
+/* Node budget per solve, 0 for none. With a fixed budget run_mcts sets it
+ * to SOLVER_FIXED_NODES instead of relying on the clock. */
+#define SOLVER_FIXED_NODES (1u << 22)
+extern __thread uint64_t solverMaxNodes;
+
+/* Solve state for the player to move within maxMs and solverMaxNodes.
+ * Returns result->solved, the state itself is left untouched. */
+int solveState(State *state, uint32_t maxMs, SolverResult *result);
+/* Forget what earlier solves left in the transposition table, so the move
+ * picked doesn't depend on them. */
+void solverClear(void);
+// Tables and budgets are per thread, this frees the calling thread's.
+void solverCleanup(void);
+
+#endif
@@ -0,0 +1,173 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "store.h"
+#include "symmetry.h"
+
+int storeEnabled = FALSE;
+
+static int storeFd = -1;
+static void *storeMap = NULL;
+static size_t storeSize = 0;
+static StoreEntry *entries = NULL;
+static uint32_t storeMask = 0;
+
+int storeOpen(const char *path, uint32_t numEntries) {
+    struct stat st;
+    uint32_t size = 1;
+    while (size < numEntries) {
+        size <<= 1;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    // Whoever gets here first sizes the file, the rest see it done.
+    flock(fd, LOCK_EX);
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        StoreHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, STORE_MAGIC, 4);
+        header.version = STORE_VERSION;
+        header.entries = size;
+        st.st_size = sizeof(StoreHeader) + (off_t)size * sizeof(StoreEntry);
+        if (ftruncate(fd, st.st_size) != 0 ||
+            pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+            close(fd);
+            return -1;
+        }
+    }
+    flock(fd, LOCK_UN);
+
+    void *map =
+        mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    const StoreHeader *header = map;
+    size_t expected =
+        sizeof(StoreHeader) + (size_t)header->entries * sizeof(StoreEntry);
+    if (memcmp(header->magic, STORE_MAGIC, 4) != 0 ||
+        header->version != STORE_VERSION || header->entries == 0 ||
+        (header->entries & (header->entries - 1)) ||
+        (size_t)st.st_size != expected) {
+        munmap(map, st.st_size);
+        close(fd);
+        return -1;
+    }
+
+    storeClose();
+    symmetryInit();
+    storeFd = fd;
+    storeMap = map;
+    storeSize = st.st_size;
+    entries = (StoreEntry *)((char *)map + sizeof(StoreHeader));
+    storeMask = header->entries - 1;
+    storeEnabled = TRUE;
+    return 0;
+}
+
+void storeClose(void) {
+    if (storeMap != NULL) {
+        munmap(storeMap, storeSize);
+        close(storeFd);
+    }
+    storeMap = NULL;
+    entries = NULL;
+    storeFd = -1;
+    storeEnabled = FALSE;
+}
+
+// 64 bit hash of a canonical position, never 0.
+static uint64_t stateKey(State *state) {
+    uint64_t h = 0x9e3779b97f4a7c15ull * (state->subBoard + 1) +
+                 (uint64_t)state->playerLastMoved;
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        h ^= state->board[b] + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        h *= 0xbf58476d1ce4e5b9ull;
+    }
+    h ^= h >> 31;
+    return h ? h : 1;
+}
+
+static StoreEntry *storeFind(uint64_t key) {
+    for (uint32_t p = 0; p < STORE_PROBE; p++) {
+        StoreEntry *entry = &entries[(key + p) & storeMask];
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+int storeLookup(State *state, uint32_t visits[BOARD_SIZE],
+                double wins[BOARD_SIZE]) {
+    State canon;
+    if (!storeEnabled) {
+        return FALSE;
+    }
+    int g = stateCanonical(state, &canon);
+    uint64_t key = stateKey(&canon);
+
+    flock(storeFd, LOCK_SH);
+    StoreEntry *entry = storeFind(key);
+    if (entry != NULL) {
+        for (int m = 0; m < BOARD_SIZE; m++) {
+            visits[m] = entry->visits[symSquare[g][m]];
+            wins[m] = entry->wins[symSquare[g][m]];
+        }
+    }
+    flock(storeFd, LOCK_UN);
+    return entry != NULL;
+}
+
+void storeUpdate(State *state, uint32_t visits[BOARD_SIZE],
+                 double wins[BOARD_SIZE]) {
+    State canon;
+    if (!storeEnabled) {
+        return;
+    }
+    int g = stateCanonical(state, &canon);
+    uint64_t key = stateKey(&canon);
+
+    flock(storeFd, LOCK_EX);
+    StoreEntry *entry = storeFind(key);
+    if (entry == NULL) {
+        // An empty slot, or else the least visited one goes.
+        for (uint32_t p = 0; p < STORE_PROBE; p++) {
+            StoreEntry *slot = &entries[(key + p) & storeMask];
+            if (entry == NULL || slot->key == 0 ||
+                (entry->key != 0 && slot->total < entry->total)) {
+                entry = slot;
+            }
+        }
+        memset(entry, 0, sizeof(StoreEntry));
+        entry->key = key;
+    }
+    for (int m = 0; m < BOARD_SIZE; m++) {
+        entry->visits[symSquare[g][m]] += visits[m];
+        entry->wins[symSquare[g][m]] += (float)wins[m];
+        entry->total += visits[m];
+    }
+    if (entry->total > STORE_MAX_VISITS) {
+        entry->total = 0;
+        for (int m = 0; m < BOARD_SIZE; m++) {
+            entry->visits[m] /= 2;
+            entry->wins[m] /= 2.0f;
+            entry->total += entry->visits[m];
+        }
+    }
+    flock(storeFd, LOCK_UN);
+}
@@ -0,0 +1,60 @@
+#ifndef __STORE_H__
+#define __STORE_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* Persistent position statistics shared between games and processes.
+ *
+ * An mmap'd hash table from canonical position (see symmetry.h) to the root
+ * child visits and wins summed over every search of that position.
+ * run_mcts seeds the root's children from it when the store is open and adds
+ * its own results back afterwards. The file is a StoreHeader then a fixed
+ * number of StoreEntries, set when it's created, which is the size cap. A
+ * key lives in one of STORE_PROBE slots after its hash, when they're all
+ * taken the one with the fewest visits is evicted.
+ *
+ * Any number of processes on a host can share the file, each opening it
+ * itself (see distServe for forked workers). Lookups hold a shared flock on
+ * it and updates an exclusive one, only for the few hundred nanoseconds each
+ * takes, and the kernel drops the lock if a holder dies. */
+
+#define STORE_MAGIC "NBPS"
+#define STORE_VERSION 1
+#define STORE_PROBE 8
+#define DEFAULT_STORE_ENTRIES (1u << 18)
+// Visit totals are halved past this so old results fade.
+#define STORE_MAX_VISITS (1u << 24)
+
+typedef struct storeHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries;
+    uint32_t reserved;
+} StoreHeader;
+
+typedef struct storeEntry {
+    // 0 for an empty slot.
+    uint64_t key;
+    uint32_t total;
+    uint32_t visits[BOARD_SIZE];
+    float wins[BOARD_SIZE];
+} StoreEntry;
+
+extern int storeEnabled;
+
+/* Opens path, creating it with entries slots (rounded up to a power of 2) if
+ * it doesn't exist. Returns 0 on success, -1 leaving the store off. */
+int storeOpen(const char *path, uint32_t entries);
+void storeClose(void);
+
+/* Stats for state's root children by move in state's own orientation.
+ * Returns 1 if the position was there. */
+int storeLookup(State *state, uint32_t visits[BOARD_SIZE],
+                double wins[BOARD_SIZE]);
+// Adds a search's root stats for state.
+void storeUpdate(State *state, uint32_t visits[BOARD_SIZE],
+                 double wins[BOARD_SIZE]);
+
+#endif
@@ -0,0 +1,431 @@
+/* Position test suite analyser.
+ *
+ * Runs run_mcts at a fixed iteration budget on every position of one or more
+ * suite files, spread over a pool of threads (see batch.h), and reports how
+ * many it solves, how far into the search the answer settled and
+ * iterations/sec. A quick strength and speed check next to full games
+ * against lookt.
+ *
+ * Suite files are EPD-like, one position per line, fields split by ';':
+ *
+ *   moves 5 1 3 7 9; bm 4; id "fork";
+ *   board xO.X...(81 marks as statePrint lays them out); am 2 6;
+ *
+ * A position is either "moves" with the opening's board and square then
+ * each square played after it, or "board" with the 81 marks of statePrint
+ * (X, O, . and the last move in lower case, nothing in between). Squares are
+ * 1-9 like the protocol. bm lists the moves that count as solving it, am the
+ * ones that fail it, at least one of the two is needed. Blank lines and lines
+ * starting with # are skipped.
+ *
+ * -G writes a suite of random positions labelled by the endgame solver, bm
+ * where the player to move has a forced win, otherwise am for the moves that
+ * throw away a draw.
+ *
+ * Example:
+ * ./suite -G 100 > tactics.suite
+ * ./suite -i 50000 tactics.suite
+ * ./suite -i 50000 -c playout_depth=2 tactics.suite
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "batch.h"
+#include "common.h"
+#include "mcts.h"
+#include "rng.h"
+#include "solver.h"
+
+#define DEFAULT_SUITE_ITERATIONS 100000
+// Longest game, one move per square.
+#define MAX_GAME_PLIES 81
+// Per child when labelling generated positions, unsolved ones are skipped.
+#define SUITE_SOLVE_MS 1000
+/* Plies played into a generated position. One more and it would have no
+ * more than SOLVER_MAX_EMPTY empty squares, and run_mcts would hand it
+ * straight to the solver. */
+#define MIN_GEN_PLIES 20
+#define MAX_GEN_PLIES (MAX_GAME_PLIES - SOLVER_MAX_EMPTY - 1)
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+typedef struct suitePosition {
+    State state;
+    // Bit n set for square n, 0-8.
+    uint16_t best;
+    uint16_t avoid;
+    char id[64];
+} SuitePosition;
+
+static SuitePosition *positions = NULL;
+static int numPositions = 0;
+static int maxPositions = 0;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-i iterations]\n");       // per position
+    printf("       [-j threads]\n");
+    printf("       [-c name=value,...]\n");   // search settings
+    mctsModelUsage();
+    printf("       [-r seed]\n");
+    printf("       [-G positions]\n");        // generate a suite instead
+    printf("       suite_file...\n");
+    exit(1);
+}
+
+static uint32_t elapsedMs(struct timeval *start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint32_t)((now.tv_sec - start->tv_sec) * 1000 +
+                      (now.tv_usec - start->tv_usec) / 1000);
+}
+
+// Squares 1-9 from a bm or am field into a mask, 0 if there's a bad one.
+static uint16_t parseSquares(char *s) {
+    uint16_t mask = 0;
+    char *end;
+    for (long sq = strtol(s, &end, 10); end != s; sq = strtol(s, &end, 10)) {
+        if (sq < 1 || sq > BOARD_SIZE) {
+            return 0;
+        }
+        mask |= 1u << (sq - 1);
+        s = end;
+    }
+    return mask;
+}
+
+// Opening board and square, then one square per move.
+static int parseMoves(char *s, State *state) {
+    char *end;
+    long board = strtol(s, &end, 10);
+    if (end == s || board < 1 || board > BOARD_SIZE) {
+        return -1;
+    }
+    s = end;
+    stateStart(state, board - 1, CROSS_PLAYER);
+    for (long sq = strtol(s, &end, 10); end != s; sq = strtol(s, &end, 10)) {
+        if (statePlay(state, (int)sq - 1) == ILLEGAL_MOVE) {
+            return -1;
+        }
+        s = end;
+    }
+    // Needs at least the opening's square.
+    return state->board[board - 1] ? 0 : -1;
+}
+
+/* Fills in pos from one suite line. Returns 1 for a position, 0 for a line
+ * to skip, -1 if it doesn't parse. */
+static int parseLine(char *line, SuitePosition *pos) {
+    char *save;
+    int havePosition = FALSE;
+    memset(pos, 0, sizeof(SuitePosition));
+    line += strspn(line, " \t");
+    if (*line == '#' || *line == '\n' || *line == '\0') {
+        return 0;
+    }
+    for (char *f = strtok_r(line, ";\n", &save); f != NULL;
+         f = strtok_r(NULL, ";\n", &save)) {
+        f += strspn(f, " \t");
+        if (strncmp(f, "moves ", 6) == 0) {
+            if (parseMoves(f + 6, &pos->state) != 0) {
+                return -1;
+            }
+            havePosition = TRUE;
+        } else if (strncmp(f, "board ", 6) == 0) {
+            if (stateParse(f + 6, &pos->state) < 0) {
+                return -1;
+            }
+            havePosition = TRUE;
+        } else if (strncmp(f, "bm ", 3) == 0) {
+            if ((pos->best = parseSquares(f + 3)) == 0) {
+                return -1;
+            }
+        } else if (strncmp(f, "am ", 3) == 0) {
+            if ((pos->avoid = parseSquares(f + 3)) == 0) {
+                return -1;
+            }
+        } else if (strncmp(f, "id ", 3) == 0) {
+            char *id = f + 3 + strspn(f + 3, " \t\"");
+            snprintf(pos->id, sizeof(pos->id), "%.*s",
+                     (int)strcspn(id, "\""), id);
+        } else if (*f != '\0') {
+            return -1;
+        }
+    }
+    if (!havePosition || (pos->best | pos->avoid) == 0 ||
+        pos->state.gameStatus != GAME_NOT_TERMINAL) {
+        return -1;
+    }
+    return 1;
+}
+
+static void loadSuite(const char *path) {
+    char line[1024];
+    int lineNo = 0;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineNo++;
+        if (numPositions == maxPositions) {
+            maxPositions = maxPositions ? maxPositions * 2 : 256;
+            positions = realloc(positions,
+                                maxPositions * sizeof(SuitePosition));
+            if (positions == NULL) {
+                perror("suite: realloc");
+                exit(1);
+            }
+        }
+        SuitePosition *pos = &positions[numPositions];
+        int parsed = parseLine(line, pos);
+        if (parsed < 0) {
+            fprintf(stderr, "%s:%d: not a suite position\n", path, lineNo);
+            exit(1);
+        } else if (parsed > 0) {
+            if (pos->id[0] == '\0') {
+                snprintf(pos->id, sizeof(pos->id), "%s:%d", path, lineNo);
+            }
+            numPositions++;
+        }
+    }
+    fclose(fp);
+}
+
+// Counts positions off on a terminal while the batch runs.
+static void suiteProgress(BatchJob *job, int index, void *arg) {
+    int *done = arg;
+    (void)job;
+    (void)index;
+    fprintf(stderr, "\r%d/%d", ++*done, numPositions);
+    if (*done == numPositions) {
+        fprintf(stderr, "\r");
+    }
+}
+
+/* Solver value of each legal move for the player to move, SOLVER_WIN/DRAW/
+ * LOSS. Returns FALSE if one didn't solve in time. */
+static int solveMoves(State *state, int values[BOARD_SIZE],
+                      uint16_t *legal) {
+    Move moves[BOARD_SIZE];
+    uint32_t nMoves;
+    stateGetMoves(state, moves, &nMoves);
+    *legal = 0;
+    for (uint32_t i = 0; i < nMoves; i++) {
+        State child = *state;
+        SolverResult solved;
+        stateDoMove(&child, moves[i]);
+        *legal |= 1u << moves[i];
+        if (child.gameStatus == GAME_WON) {
+            values[moves[i]] = SOLVER_WIN;
+        } else if (child.gameStatus == GAME_DRAWN) {
+            values[moves[i]] = SOLVER_DRAW;
+        } else if (solveState(&child, SUITE_SOLVE_MS, &solved)) {
+            values[moves[i]] = -solved.outcome;
+        } else {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void printSquares(const char *op, uint16_t mask) {
+    printf(" %s", op);
+    for (int sq = 0; sq < BOARD_SIZE; sq++) {
+        if (mask & (1u << sq)) {
+            printf(" %d", sq + 1);
+        }
+    }
+    printf(";");
+}
+
+/* Random positions the solver can settle, kept when some move gets it wrong
+ * and there's no line to finish straight away. Early enough that run_mcts
+ * has to search them rather than hand them to the solver. */
+static void generateSuite(int count) {
+    int made = 0;
+    while (made < count) {
+        Move played[MAX_GAME_PLIES];
+        int plies = 0;
+        int board = rngNext() % BOARD_SIZE;
+        State state;
+        stateStart(&state, board, CROSS_PLAYER);
+        int target =
+            MIN_GEN_PLIES + rngNext() % (MAX_GEN_PLIES - MIN_GEN_PLIES + 1);
+        while (plies < target && state.gameStatus == GAME_NOT_TERMINAL) {
+            Move moves[BOARD_SIZE];
+            uint32_t nMoves;
+            stateGetMoves(&state, moves, &nMoves);
+            played[plies] = moves[rngNext() % nMoves];
+            stateDoMove(&state, played[plies++]);
+        }
+        int player = 3 - state.playerLastMoved;
+        if (state.gameStatus != GAME_NOT_TERMINAL ||
+            stateThreats(state.board[state.subBoard], player)) {
+            continue;
+        }
+
+        int values[BOARD_SIZE];
+        uint16_t legal;
+        if (!solveMoves(&state, values, &legal)) {
+            continue;
+        }
+        int bestValue = SOLVER_LOSS;
+        uint16_t best = 0;
+        for (int sq = 0; sq < BOARD_SIZE; sq++) {
+            if ((legal & (1u << sq)) && values[sq] > bestValue) {
+                bestValue = values[sq];
+            }
+        }
+        for (int sq = 0; sq < BOARD_SIZE; sq++) {
+            if ((legal & (1u << sq)) && values[sq] == bestValue) {
+                best |= 1u << sq;
+            }
+        }
+        if (bestValue == SOLVER_LOSS || best == legal) {
+            continue;
+        }
+
+        printf("moves %d", board + 1);
+        for (int p = 0; p < plies; p++) {
+            printf(" %d", played[p] + 1);
+        }
+        printf(";");
+        if (bestValue == SOLVER_WIN) {
+            printSquares("bm", best);
+        } else {
+            printSquares("am", legal & ~best);
+        }
+        printf(" id \"gen-%d-%s\";\n", ++made,
+               bestValue == SOLVER_WIN ? "win" : "draw");
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    char *policyFile = NULL;
+    char *netFile = NULL;
+    unsigned int seed = 1;
+    int generate = 0;
+    int i = 1;
+
+    maxIterations = DEFAULT_SUITE_ITERATIONS;
+    fixedBudget = TRUE;
+    mctsConfig.adaptiveTime = FALSE;
+    while (i < argc && argv[i][0] == '-') {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-i") == 0) {
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            numThreads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            if (mctsConfigParse(&mctsConfig, argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-w") == 0) {
+            policyFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            netFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-G") == 0) {
+            generate = atoi(argv[i + 1]);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+
+    if (generate > 0) {
+        rngSeed(seed);
+        generateSuite(generate);
+        return 0;
+    }
+    if (i == argc) {
+        usage(argv[0]);
+    }
+    for (; i < argc; i++) {
+        loadSuite(argv[i]);
+    }
+    if (mctsLoadModels(policyFile, netFile) != 0) {
+        return 1;
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    if (numThreads > numPositions) {
+        numThreads = numPositions > 0 ? numPositions : 1;
+    }
+
+    BatchJob *jobs = calloc(numPositions + 1, sizeof(BatchJob));
+    if (jobs == NULL) {
+        perror("suite: calloc");
+        return 1;
+    }
+    for (int p = 0; p < numPositions; p++) {
+        jobs[p].state = positions[p].state;
+        jobs[p].lastMove = positions[p].state.subBoard;
+        jobs[p].maxIterations = maxIterations;
+        jobs[p].fixedBudget = TRUE;
+        // Seeded per position so results don't depend on the thread count.
+        jobs[p].seed = seed + (uint64_t)p;
+        jobs[p].confidence = 0.5;
+    }
+    if (batchStart(numThreads) != 0) {
+        fprintf(stderr, "suite: couldn't start %d threads\n", numThreads);
+        return 1;
+    }
+
+    struct timeval start;
+    int done = 0;
+    gettimeofday(&start, NULL);
+    batchSearch(jobs, numPositions, isatty(2) ? suiteProgress : NULL, &done);
+    uint32_t wallMs = elapsedMs(&start);
+    batchStop();
+
+    int solved = 0;
+    uint64_t iterations = 0;
+    uint64_t searchMs = 0;
+    uint64_t settledIterations = 0;
+    uint64_t settledMs = 0;
+    for (int p = 0; p < numPositions; p++) {
+        SuitePosition *pos = &positions[p];
+        BatchJob *r = &jobs[p];
+        uint16_t move = 1u << r->move;
+        int ok = (!pos->best || (pos->best & move)) && !(pos->avoid & move);
+        iterations += r->stats.iterations;
+        searchMs += r->stats.elapsedMs;
+        if (ok) {
+            solved++;
+            settledIterations += r->stats.settledIterations;
+            settledMs += r->stats.settledMs;
+        }
+        printf("%-24s %s move %d settled %u iters %ums\n", pos->id,
+               ok ? "ok  " : "FAIL", r->move + 1, r->stats.settledIterations,
+               r->stats.settledMs);
+    }
+    printf("\nsolved %d/%d (%.1lf%%) at %u iterations\n", solved,
+           numPositions, numPositions ? 100.0 * solved / numPositions : 0.0,
+           maxIterations);
+    if (solved > 0) {
+        printf("settled after %.0lf iterations, %.1lfms on average\n",
+               (double)settledIterations / solved, (double)settledMs / solved);
+    }
+    printf("%.0lf iterations/sec a thread, %.0lf/sec over %d threads in "
+           "%.2lfs\n",
+           searchMs ? 1000.0 * iterations / searchMs : 0.0,
+           wallMs ? 1000.0 * iterations / wallMs : 0.0, numThreads,
+           wallMs / 1000.0);
+    free(jobs);
+    return 0;
+}
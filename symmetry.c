@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "symmetry.h"
+
+#define TRUE 1
+#define FALSE 0
+
+uint8_t symSquare[NUM_SYMMETRIES][BOARD_SIZE];
+uint8_t symInverse[NUM_SYMMETRIES];
+// Same as symSquare but on a whole 9 bit pattern.
+static uint16_t symPattern[NUM_SYMMETRIES][512];
+// Bitmask of the symmetries that leave each square where it is.
+static uint32_t symFixes[BOARD_SIZE];
+static int symReady = FALSE;
+
+// Where (row, col) goes under g.
+static int symApply(int g, int r, int c) {
+    switch (g) {
+    case 1: return c * 3 + (2 - r);       // rotate 90
+    case 2: return (2 - r) * 3 + (2 - c); // rotate 180
+    case 3: return (2 - c) * 3 + r;       // rotate 270
+    case 4: return r * 3 + (2 - c);       // mirror left/right
+    case 5: return (2 - r) * 3 + c;       // mirror top/bottom
+    case 6: return c * 3 + r;             // main diagonal
+    case 7: return (2 - c) * 3 + (2 - r); // anti diagonal
+    default: return r * 3 + c;
+    }
+}
+
+void symmetryInit(void) {
+    if (symReady) {
+        return;
+    }
+    memset(symFixes, 0, sizeof(symFixes));
+    for (int g = 0; g < NUM_SYMMETRIES; g++) {
+        for (int s = 0; s < BOARD_SIZE; s++) {
+            symSquare[g][s] = (uint8_t)symApply(g, s / 3, s % 3);
+            if (g != 0 && symSquare[g][s] == s) {
+                symFixes[s] |= 1u << g;
+            }
+        }
+        for (uint32_t p = 0; p < 512; p++) {
+            uint16_t q = 0;
+            for (int s = 0; s < BOARD_SIZE; s++) {
+                if (p & (1u << s)) {
+                    q |= 1u << symSquare[g][s];
+                }
+            }
+            symPattern[g][p] = q;
+        }
+    }
+    for (int g = 0; g < NUM_SYMMETRIES; g++) {
+        for (int h = 0; h < NUM_SYMMETRIES; h++) {
+            if (symSquare[h][symSquare[g][1]] == 1 &&
+                symSquare[h][symSquare[g][2]] == 2) {
+                symInverse[g] = (uint8_t)h;
+            }
+        }
+    }
+    symReady = TRUE;
+}
+
+static inline uint32_t boardTransform(uint32_t board, int g) {
+    return symPattern[g][board & ALL_CIRCLES_MASK] |
+           (uint32_t)symPattern[g][(board & ALL_CROSSES_MASK) >> 9u] << 9u;
+}
+
+void stateTransform(State *in, State *out, int g) {
+    State tmp = *in;
+    for (int b = 0; b < BOARD_SIZE; b++) {
+        tmp.board[symSquare[g][b]] = boardTransform(in->board[b], g);
+    }
+    tmp.subBoard = symSquare[g][in->subBoard];
+    *out = tmp;
+}
+
+uint32_t stateSymmetries(State *state) {
+    uint32_t candidates = symFixes[state->subBoard];
+    uint32_t syms = 0;
+
+    while (candidates) {
+        int g = __builtin_ctz(candidates);
+        candidates &= candidates - 1;
+        int b;
+        for (b = 0; b < BOARD_SIZE; b++) {
+            if (boardTransform(state->board[b], g) !=
+                state->board[symSquare[g][b]]) {
+                break;
+            }
+        }
+        if (b == BOARD_SIZE) {
+            syms |= 1u << g;
+        }
+    }
+    return syms;
+}
+
+static int stateCompare(State *a, State *b) {
+    if (a->subBoard != b->subBoard) {
+        return a->subBoard < b->subBoard ? -1 : 1;
+    }
+    return memcmp(a->board, b->board, sizeof(a->board));
+}
+
+int stateCanonical(State *in, State *out) {
+    State cur;
+    int best = 0;
+    *out = *in;
+    for (int g = 1; g < NUM_SYMMETRIES; g++) {
+        stateTransform(in, &cur, g);
+        if (stateCompare(&cur, out) < 0) {
+            *out = cur;
+            best = g;
+        }
+    }
+    return best;
+}
+
+void symmetryPruneMoves(uint32_t syms, Move moves[BOARD_SIZE],
+                        uint32_t *numMoves) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < *numMoves; i++) {
+        uint32_t rest = syms;
+        int keep = TRUE;
+        while (rest && keep) {
+            int g = __builtin_ctz(rest);
+            rest &= rest - 1;
+            keep = symSquare[g][moves[i]] >= moves[i];
+        }
+        if (keep) {
+            moves[n++] = moves[i];
+        }
+    }
+    *numMoves = n;
+}
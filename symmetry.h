@@ -0,0 +1,35 @@
+#ifndef __SYMMETRY_H__
+#define __SYMMETRY_H__
+
+#include <stdint.h>
+
+#include "mcts.h"
+
+/* The 8 symmetries of the square, applied the same way to the board of
+ * boards and to every sub-board. Symmetry 0 is the identity. */
+#define NUM_SYMMETRIES 8
+// Only nodes this close to the root get their symmetric moves merged.
+#define SYMMETRY_MAX_DEPTH 3
+
+// symSquare[g][s] is where square (or sub-board) s ends up under g.
+extern uint8_t symSquare[NUM_SYMMETRIES][BOARD_SIZE];
+// symInverse[g] undoes g.
+extern uint8_t symInverse[NUM_SYMMETRIES];
+
+// Builds the lookup tables, safe to call more than once.
+void symmetryInit(void);
+
+// out = g(in).
+void stateTransform(State *in, State *out, int g);
+/* Bitmask of the non identity symmetries that map state onto itself. Rejects
+ * on the current sub-board first so asymmetric positions cost a few loads. */
+uint32_t stateSymmetries(State *state);
+/* Writes the smallest of the 8 transforms of in to out and returns the g with
+ * out = g(in). */
+int stateCanonical(State *in, State *out);
+/* Drops moves that some symmetry in syms maps to a smaller move, leaving one
+ * move per equivalence class. */
+void symmetryPruneMoves(uint32_t syms, Move moves[BOARD_SIZE],
+                        uint32_t *numMoves);
+
+#endif
@@ -9,6 +9,9 @@ from math import *
 base_port = 12340
 port_mod = 0
 lookt_depth = 16
+# Reference opponent, either the prebuilt lookt or the in-tree abt. Both take
+# -d depth.
+opponent = "lookt"
 num_workers = 5
 
 c_vals = (0.4, 1, 1.3, 2)
@@ -28,7 +31,7 @@ def create_queue_from_json(fp):
 
 async def game(port, lookt_depth, first, exp_c, pbar, start_moves):
     servt = f"./servt -p {port} -m {start_moves[0]} {start_moves[1]}"
-    lookt = f"./lookt -p {port} -d {lookt_depth}"
+    lookt = f"./{opponent} -p {port} -d {lookt_depth}"
     agent = f"./agent -p {port}"
 
     serv_p = await asyncio.create_subprocess_shell(servt,
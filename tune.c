@@ -0,0 +1,384 @@
+/* SPSA tuner for the search settings.
+ *
+ * Each iteration nudges every tuned setting up or down at random by c_k,
+ * plays a game pair between the two sides of the nudge (or each of them
+ * against a fixed reference with -R) and moves the settings towards the one
+ * that scored better by a_k, with the usual schedules c_k = c / k^0.101 and
+ * a_k = a / (A + k)^0.602. Pairs run on one worker process per core and
+ * results are applied as they come back, so every core stays busy.
+ *
+ * Settings are given as name,min,max,c_end with -p, c_end being how far the
+ * last iterations still perturb it. By default it tunes the exploration
+ * constants and, unless the moves have a fixed number of iterations, the
+ * turn times and the confidence thresholds that cut turns short. Games then
+ * run under servt's clock, 30s plus 2s a move scaled by -T, and running out
+ * loses, so longer turns have to pay for themselves.
+ *
+ * Example, overnight with the clock at a tenth of the real one:
+ * ./tune -n 20000 -T 0.1 > tune.log
+ * ./tune -i 5000 -p ucb_c,0.2,3,0.2 -p ucb_variance,0.05,1,0.05
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "common.h"
+#include "mcts.h"
+#include "proto.h"
+#include "rng.h"
+
+#define MAX_TUNE_PARAMS 16
+#define MAX_TUNE_WORKERS 256
+#define DEFAULT_TUNE_ITERATIONS 5000
+#define DEFAULT_TIME_SCALE 0.1
+// SPSA schedule, as commonly used for engine tuning.
+#define SPSA_ALPHA 0.602
+#define SPSA_GAMMA 0.101
+// a_end = r_end * c_end^2, how far a decided pair moves a setting at the end.
+#define SPSA_R_END 0.002
+
+// run_mcts reports through these when verbose.
+int verbose = FALSE;
+int moveNo;
+
+typedef struct tuneParam {
+    char name[32];
+    double value;
+    double min;
+    double max;
+    // Perturbation at the last iteration.
+    double cEnd;
+} TuneParam;
+
+// One iteration for a worker: the two perturbed settings and a seed.
+typedef struct tuneJob {
+    uint32_t k;
+    uint64_t seed;
+    MctsConfig plus;
+    MctsConfig minus;
+} TuneJob;
+
+typedef struct tuneResult {
+    uint32_t k;
+    // Wins minus losses of plus against minus, or against the reference.
+    int score;
+} TuneResult;
+
+static TuneParam params[MAX_TUNE_PARAMS];
+static int numParams = 0;
+
+// Given with -R, plus and minus each play it instead of each other.
+static MctsConfig reference;
+static int haveReference = FALSE;
+// The clock and turn times are scaled by this, unused with -i.
+static double timeScale = DEFAULT_TIME_SCALE;
+
+static void usage(char argv0[]) {
+    printf("Usage: %s\n", argv0);
+    printf("       [-c name=value,...]\n");    // starting point
+    printf("       [-p name,min,max,c_end]\n"); // setting to tune, repeatable
+    printf("       [-R name=value,...]\n");    // reference opponent
+    printf("       [-n iterations]\n");        // game pairs
+    printf("       [-i iterations]\n");        // per move, no clock
+    printf("       [-T scale]\n");             // of the clock and turns
+    printf("       [-j workers]\n");
+    mctsModelUsage();
+    printf("       [-r seed]\n");
+    exit(1);
+}
+
+static void addParam(const char *name, double min, double max, double cEnd) {
+    if (numParams == MAX_TUNE_PARAMS) {
+        fprintf(stderr, "tune: too many settings\n");
+        exit(1);
+    }
+    TuneParam *p = &params[numParams++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->min = min;
+    p->max = max;
+    p->cEnd = cEnd;
+}
+
+static void addDefaultParams(void) {
+    addParam("ucb_c", 0.2, 3.0, 0.2);
+    addParam("ucb_variance", 0.02, 1.0, 0.04);
+    if (!fixedBudget) {
+        addParam("confident_high", 0.55, 1.0, 0.03);
+        addParam("confident_low", 0.0, 0.45, 0.03);
+        addParam("first_turn_ms", 100, 4000, 150);
+        addParam("fast_turn_ms", 100, 6000, 250);
+        addParam("max_turn_ms", 100, 8000, 300);
+        addParam("end_turn_ms", 100, 6000, 250);
+    }
+}
+
+static double clamp(double v, double min, double max) {
+    return v < min ? min : v > max ? max : v;
+}
+
+// Perturbation of param on iteration k of n, c_end on the last one.
+static double spsaC(TuneParam *param, uint32_t k, uint32_t n) {
+    return param->cEnd * pow((double)n / k, SPSA_GAMMA);
+}
+
+static void printParams(FILE *fp) {
+    for (int p = 0; p < numParams; p++) {
+        fprintf(fp, "%s%s=%g", p ? "," : "", params[p].name, params[p].value);
+    }
+    fprintf(fp, "\n");
+}
+
+// Under the clock unless moves have a fixed budget.
+static int playGame(MctsConfig *cross, MctsConfig *circle, int board,
+                    int square) {
+    if (fixedBudget) {
+        return mctsPlayGame(cross, circle, board, square, UINT32_MAX);
+    }
+    return mctsPlayTimedGame(cross, circle, board, square, timeScale);
+}
+
+// Wins minus losses for a over a pair of games from the same opening.
+static int playPair(MctsConfig *a, MctsConfig *b, int board, int square) {
+    int score = 0;
+    int winner = playGame(a, b, board, square);
+    score += winner == CROSS_PLAYER ? 1 : winner == CIRCLE_PLAYER ? -1 : 0;
+    winner = playGame(b, a, board, square);
+    score += winner == CIRCLE_PLAYER ? 1 : winner == CROSS_PLAYER ? -1 : 0;
+    return score;
+}
+
+static void tuneWorker(int fd) {
+    TuneJob job;
+    while (protoFullIo(fd, &job, sizeof(job), FALSE, -1) == 0) {
+        TuneResult result;
+        rngSeed(job.seed);
+        int board = rngNext() % 9;
+        int square = rngNext() % 9;
+        result.k = job.k;
+        if (haveReference) {
+            result.score = playPair(&job.plus, &reference, board, square) -
+                           playPair(&job.minus, &reference, board, square);
+        } else {
+            result.score = playPair(&job.plus, &job.minus, board, square);
+        }
+        if (protoFullIo(fd, &result, sizeof(result), TRUE, -1) != 0) {
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    MctsConfig base = mctsConfig;
+    int numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t iterations = DEFAULT_TUNE_ITERATIONS;
+    char *policyFile = NULL;
+    char *netFile = NULL;
+    unsigned int seed = 1;
+    int i = 1;
+
+    reference = mctsConfig;
+    while (i < argc) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (strcmp(argv[i], "-c") == 0) {
+            if (mctsConfigParse(&base, argv[i + 1])) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-p") == 0) {
+            char name[32];
+            double min, max, cEnd;
+            if (sscanf(argv[i + 1], "%31[^,],%lf,%lf,%lf", name, &min, &max,
+                       &cEnd) != 4 ||
+                min >= max || cEnd <= 0.0) {
+                usage(argv[0]);
+            }
+            addParam(name, min, max, cEnd);
+        } else if (strcmp(argv[i], "-R") == 0) {
+            if (mctsConfigParse(&reference, argv[i + 1])) {
+                usage(argv[0]);
+            }
+            haveReference = TRUE;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            iterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            maxIterations = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            if (maxIterations < 1) {
+                usage(argv[0]);
+            }
+            fixedBudget = TRUE;
+        } else if (strcmp(argv[i], "-T") == 0) {
+            timeScale = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            numWorkers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-w") == 0) {
+            policyFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            netFile = argv[i + 1];
+        } else if (strcmp(argv[i], "-r") == 0) {
+            seed = (unsigned int)strtoul(argv[i + 1], NULL, 10);
+        } else {
+            usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (iterations == 0 || timeScale <= 0.0) {
+        usage(argv[0]);
+    }
+    if (numWorkers < 1) {
+        numWorkers = 1;
+    } else if (numWorkers > MAX_TUNE_WORKERS) {
+        numWorkers = MAX_TUNE_WORKERS;
+    }
+    if (numParams == 0) {
+        addDefaultParams();
+    }
+    for (int p = 0; p < numParams; p++) {
+        if (mctsConfigGet(&base, params[p].name, &params[p].value) != 0) {
+            fprintf(stderr, "tune: no setting %s\n", params[p].name);
+            return 1;
+        }
+        params[p].value = clamp(params[p].value, params[p].min, params[p].max);
+    }
+    if (mctsLoadModels(policyFile, netFile) != 0) {
+        return 1;
+    }
+    rngSeed(seed);
+
+    printf("base: ");
+    mctsConfigPrint(stdout, &base);
+    printf("tuning %u pairs on %d workers, %s\n", iterations, numWorkers,
+           haveReference ? "against the reference" : "self-play");
+    printf("start: ");
+    printParams(stdout);
+    fflush(stdout);
+
+    int fds[MAX_TUNE_WORKERS];
+    pid_t pids[MAX_TUNE_WORKERS];
+    for (int w = 0; w < numWorkers; w++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            perror("tune: socketpair");
+            return 1;
+        }
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("tune: fork");
+            return 1;
+        } else if (pids[w] == 0) {
+            for (int o = 0; o < w; o++) {
+                close(fds[o]);
+            }
+            close(pair[0]);
+            tuneWorker(pair[1]);
+            _exit(0);
+        }
+        close(pair[1]);
+        fds[w] = pair[0];
+    }
+
+    // The SPSA schedule, with A a tenth of the run.
+    double bigA = 0.1 * iterations;
+    // The perturbation each worker's pair was played with.
+    signed char deltas[MAX_TUNE_WORKERS][MAX_TUNE_PARAMS];
+    // Iteration each worker is on, 0 when idle.
+    uint32_t jobK[MAX_TUNE_WORKERS] = {0};
+    uint32_t sent = 0, done = 0;
+    long total = 0;
+    while (done < iterations) {
+        // Hand every idle worker the next iteration.
+        for (int w = 0; w < numWorkers && sent < iterations; w++) {
+            if (jobK[w] != 0) {
+                continue;
+            }
+            TuneJob job;
+            uint32_t k = ++sent;
+            job.k = k;
+            job.seed = ((uint64_t)rngNext() << 32) | rngNext();
+            job.plus = base;
+            job.minus = base;
+            for (int p = 0; p < numParams; p++) {
+                TuneParam *param = &params[p];
+                double c = spsaC(param, k, iterations);
+                deltas[w][p] = rngNext() & 1 ? 1 : -1;
+                mctsConfigSet(&job.plus, param->name,
+                              clamp(param->value + c * deltas[w][p],
+                                    param->min, param->max));
+                mctsConfigSet(&job.minus, param->name,
+                              clamp(param->value - c * deltas[w][p],
+                                    param->min, param->max));
+            }
+            if (protoFullIo(fds[w], &job, sizeof(job), TRUE, -1) != 0) {
+                fprintf(stderr, "tune: lost worker %d\n", w);
+                return 1;
+            }
+            jobK[w] = k;
+        }
+
+        struct pollfd pfds[MAX_TUNE_WORKERS];
+        for (int w = 0; w < numWorkers; w++) {
+            pfds[w].fd = jobK[w] ? fds[w] : -1;
+            pfds[w].events = POLLIN;
+        }
+        if (poll(pfds, numWorkers, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("tune: poll");
+            return 1;
+        }
+        for (int w = 0; w < numWorkers; w++) {
+            TuneResult result;
+            if (!(pfds[w].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            if (protoFullIo(fds[w], &result, sizeof(result), FALSE, -1) != 0) {
+                fprintf(stderr, "tune: lost worker %d\n", w);
+                return 1;
+            }
+            uint32_t k = jobK[w];
+            jobK[w] = 0;
+            done++;
+            total += result.score;
+            for (int p = 0; p < numParams; p++) {
+                TuneParam *param = &params[p];
+                double aEnd = SPSA_R_END * param->cEnd * param->cEnd;
+                double a = aEnd * pow(bigA + iterations, SPSA_ALPHA) /
+                           pow(bigA + k, SPSA_ALPHA);
+                double c = spsaC(param, k, iterations);
+                param->value =
+                    clamp(param->value + a * result.score * deltas[w][p] / c,
+                          param->min, param->max);
+                mctsConfigSet(&base, param->name, param->value);
+            }
+            if (done % 10 == 0 || done == iterations) {
+                printf("%u: ", done);
+                printParams(stdout);
+                fflush(stdout);
+            }
+            fprintf(stderr, "\r%u/%u pairs, plus-minus %+ld ", done,
+                    iterations, total);
+        }
+    }
+    fprintf(stderr, "\n");
+    for (int w = 0; w < numWorkers; w++) {
+        close(fds[w]);
+    }
+    while (wait(NULL) > 0) {
+    }
+
+    // Integer settings as they'll actually be used.
+    for (int p = 0; p < numParams; p++) {
+        mctsConfigGet(&base, params[p].name, &params[p].value);
+    }
+    printf("tuned: ");
+    printParams(stdout);
+    return 0;
+}